@@ -9,11 +9,14 @@
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
+#include <sstream>
 #include <string>
 #include <vector>
+#include <stdint.h>
 
 #include "bigmemoryDefines.h"
 #include "SharedCounter.h"
+#include "ZoneMap.h"
 
 using namespace std;
 
@@ -28,12 +31,15 @@ class BigMatrix : public boost::noncopyable
   // Public types
   public:
     enum MatrixType {CHAR=1, SHORT=2, INT=3, DOUBLE=4, COMPLEX=5, FLOAT=6};
+    // How the data regions are mapped; the values may be or-ed together.
+    enum MapPolicy {POLICY_DEFAULT=0, POLICY_HUGEPAGES=1, POLICY_PREFAULT=2};
 
   // Constructor and Destructor
   public:
     BigMatrix():_ncol(0),_nrow(0), _totalRows(0), _totalCols(0),
                 _colOffset(0), _rowOffset(0),_matType(0), _pdata(NULL),
-                _sepCols(false), _readOnly(false), _allocationSize(0){}
+                _sepCols(false), _readOnly(false), _allocationSize(0),
+                _mapPolicy(POLICY_DEFAULT){}
     virtual ~BigMatrix(){}
 
     // The next function returns the matrix data.  It will generally be passed
@@ -159,6 +165,18 @@ class BigMatrix : public boost::noncopyable
   
     const index_type allocation_size() const {return _allocationSize;}
 
+    int map_policy() const {return _mapPolicy;}
+    // Only shared and file-backed matrices have regions to apply a 
+    // policy to.
+    virtual bool map_policy( const int newPolicy )
+    {
+      return newPolicy == POLICY_DEFAULT;
+    }
+    // Make column i what was column order[i] without moving any data.
+    // Only a separated matrix that no other object can attach to can do
+    // this, since the order lives in this object's table of columns.
+    virtual bool permute_columns( const Columns &order ) {return false;}
+
   // Data Members
 
   protected:
@@ -177,6 +195,7 @@ class BigMatrix : public boost::noncopyable
     Names _rowNames;
     bool _readOnly;
     index_type _allocationSize;
+    int _mapPolicy;
 };
 
 class LocalBigMatrix : public BigMatrix
@@ -186,6 +205,7 @@ class LocalBigMatrix : public BigMatrix
     virtual ~LocalBigMatrix() {destroy();};
     virtual bool create( const index_type numRow, const index_type numCol,
       const int matrixType, const bool sepCols);
+    virtual bool permute_columns( const Columns &order );
 
   protected:
     virtual bool destroy();
@@ -198,6 +218,16 @@ class SharedBigMatrix : public BigMatrix
     virtual ~SharedBigMatrix() {}
     std::string uuid() const {return _uuid;}
     std::string shared_name() const {return _sharedName;}
+    using BigMatrix::map_policy;
+    virtual bool map_policy( const int newPolicy );
+
+    // Tell the kernel how the rows [firstRow, lastRow) of the columns
+    // [firstCol, lastCol) are about to be used.
+    enum AccessPattern {ADVICE_NORMAL=0, ADVICE_SEQUENTIAL, ADVICE_RANDOM,
+      ADVICE_WILLNEED, ADVICE_DONTNEED};
+    bool advise( const int pattern, const index_type firstRow,
+      const index_type lastRow, const index_type firstCol,
+      const index_type lastCol );
 
   protected:
     virtual bool destroy()=0;
@@ -213,6 +243,15 @@ class SharedBigMatrix : public BigMatrix
     bool create_uuid();
     bool uuid(const std::string &uuid) {_uuid=uuid; return true;}
 
+    // Apply op to the bytes of the mapped regions that hold the rows 
+    // [firstRow, lastRow) of the columns [firstCol, lastCol).  Each span
+    // is given as [begin, end) offsets within its region.
+    typedef bool (*SpanOperation)( MappedRegion &region, index_type begin,
+      index_type end, int arg );
+    bool for_each_span( SpanOperation op, const int arg,
+      const index_type firstRow, const index_type lastRow,
+      const index_type firstCol, const index_type lastCol );
+
   protected:
     std::string _uuid;
     std::string _sharedName;
@@ -237,27 +276,91 @@ class SharedMemoryBigMatrix : public SharedBigMatrix
     SharedCounter _counter;
 }; 
 
+// A file-backed matrix may describe itself in a header at the start of
+// its backing file (for separated columns, in a file of its own named
+// after the matrix).  The data then begins at dataOffset, which is a
+// multiple of the page size and of the Windows allocation granularity,
+// and the dimnames are stored in the block at namesOffset.
+struct BackingFileHeader
+{
+  char magic[8];
+  uint32_t byteOrder;
+  uint32_t version;
+  int32_t matrixType;
+  int32_t sepCols;
+  int64_t totalRows;
+  int64_t totalCols;
+  int64_t dataOffset;
+  int64_t namesOffset;
+  int64_t namesLength;
+};
+
+const char BACKING_HEADER_MAGIC[8] = {'B','I','G','M','E','M','R','Y'};
+const uint32_t BACKING_HEADER_BYTE_ORDER = 0x01020304;
+const uint32_t BACKING_HEADER_VERSION = 1;
+const index_type BACKING_HEADER_SIZE = 65536;
+
 class FileBackedBigMatrix : public SharedBigMatrix
 {
   // _sharedName is filename_uuid
   public:
-    FileBackedBigMatrix():SharedBigMatrix(){}
+    FileBackedBigMatrix():SharedBigMatrix(),_dataOffset(0),_embedded(false){}
     virtual ~FileBackedBigMatrix(){destroy();}
     virtual bool create( const std::string &fileName, 
       const std::string &filePath,const index_type numRow, 
-      const index_type numCol, const int matrixType, const bool sepCols);
+      const index_type numCol, const int matrixType, const bool sepCols,
+      const bool embedHeader=false);
     virtual bool connect( const std::string &fileName, 
       const std::string &filePath, const index_type numRow, 
       const index_type numCol, const int matrixType, const bool sepCols,
       const bool readOnly=false);
+    // Connect using only the header embedded in the backing file.
+    bool attach( const std::string &fileName, const std::string &filePath,
+      const bool readOnly=false);
+    // Record the current dimensions and dimnames in the embedded header.
+    // Called on creation and whenever the dimnames change.
+    bool write_header();
     std::string file_name() const {return _fileName;}
     std::string file_path() const {return _filePath;}
-    bool flush();
+    bool embedded_header() const {return _embedded;}
+    // The position of the data in the (non-separated) backing file.
+    index_type data_offset() const {return _dataOffset;}
+    // The file holding the data of column col, or of the whole matrix 
+    // when the columns are not separated.
+    std::string backing_file( const index_type col=0 ) const
+    {
+      if (!_sepCols)
+      {
+        return _filePath + _fileName;
+      }
+      std::ostringstream name;
+      name << _filePath << _fileName << "_column_" << col;
+      return name.str();
+    }
+    // The optional per-column block summaries used by mwhich, kept in
+    // their own file next to the backing file.  Enabling creates the file
+    // (with every column out of date), disabling removes it; matrices
+    // attached later pick it up automatically.
+    std::string zone_map_file() const 
+    {
+      return _filePath + _fileName + ".zonemap";
+    }
+    ZoneMap* zone_map() const {return _zoneMap.get();}
+    bool zone_map( const bool enable );
+    // An asynchronous flush schedules the writes and returns at once.
+    bool flush( const bool async=false );
+    bool flush( const index_type firstRow, const index_type lastRow,
+      const index_type firstCol, const index_type lastCol,
+      const bool async=false );
   protected:
     virtual bool destroy();
+    bool map_files();
 
   protected:
     std::string _fileName, _filePath;
+    index_type _dataOffset;
+    bool _embedded;
+    boost::shared_ptr<ZoneMap> _zoneMap;
 };
 
 #endif // BIGMATRIX_H
@@ -0,0 +1,320 @@
+#ifndef BIGMEMORY_ELEMENTKERNELS_HPP
+#define BIGMEMORY_ELEMENTKERNELS_HPP
+
+// Bulk conversion between the element types of a big.matrix and the R
+// vectors they are read from and into.  The extraction and assignment
+// code hands these kernels whole runs of consecutive elements rather than
+// going one index at a time, so a slice like x[1:1e7, 5:10] turns into a
+// handful of memcpy calls (when the C and R types agree) or vectorized
+// conversions.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "bigmemoryDefines.h"
+#include "isna.hpp"
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+// Copy n elements to R, replacing the C missing value with R's.
+template<typename CType, typename RType>
+inline void ToRValues( const CType *src, index_type n, RType *dst,
+  double NA_C, double NA_R )
+{
+  const CType naC = static_cast<CType>(NA_C);
+  const RType naR = static_cast<RType>(NA_R);
+  index_type i;
+  for (i=0; i < n; ++i)
+  {
+    dst[i] = (src[i] == naC) ? naR : static_cast<RType>(src[i]);
+  }
+}
+
+// int and double share their missing values with R.
+inline void ToRValues( const int *src, index_type n, int *dst,
+  double NA_C, double NA_R )
+{
+  memcpy(dst, src, n*sizeof(int));
+}
+
+inline void ToRValues( const double *src, index_type n, double *dst,
+  double NA_C, double NA_R )
+{
+  memcpy(dst, src, n*sizeof(double));
+}
+
+// Float values only need widening when the caller keeps NA_FLOAT as it
+// is; otherwise it becomes NA_R like any other type.
+inline void ToRValues( const float *src, index_type n, double *dst,
+  double NA_C, double NA_R )
+{
+  if (NA_C != NA_R)
+  {
+    ToRValues<float, double>(src, n, dst, NA_C, NA_R);
+    return;
+  }
+  index_type i;
+  for (i=0; i < n; ++i)
+  {
+    dst[i] = static_cast<double>(src[i]);
+  }
+}
+
+#if defined(__SSE2__)
+// Sign-extend the char and short types to int four lanes at a time and
+// blend in NA_INTEGER wherever the source held its own NA.
+inline void StoreWidened( int *dst, __m128i val, __m128i isNA )
+{
+  const __m128i naR = _mm_set1_epi32(NA_INTEGER);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+    _mm_or_si128(_mm_and_si128(isNA, naR), _mm_andnot_si128(isNA, val)));
+}
+
+inline void WidenShorts( int *dst, __m128i v, __m128i isNA )
+{
+  const __m128i sign = _mm_cmplt_epi16(v, _mm_setzero_si128());
+  StoreWidened(dst, _mm_unpacklo_epi16(v, sign),
+    _mm_unpacklo_epi16(isNA, isNA));
+  StoreWidened(dst+4, _mm_unpackhi_epi16(v, sign),
+    _mm_unpackhi_epi16(isNA, isNA));
+}
+
+inline void ToRValues( const short *src, index_type n, int *dst,
+  double NA_C, double NA_R )
+{
+  const __m128i naC = _mm_set1_epi16(static_cast<short>(NA_C));
+  index_type i=0;
+  for (; i+8 <= n; i += 8)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i));
+    WidenShorts(dst+i, v, _mm_cmpeq_epi16(v, naC));
+  }
+  ToRValues<short, int>(src+i, n-i, dst+i, NA_C, NA_R);
+}
+
+inline void ToRValues( const char *src, index_type n, int *dst,
+  double NA_C, double NA_R )
+{
+  const __m128i naC = _mm_set1_epi8(static_cast<char>(NA_C));
+  index_type i=0;
+  for (; i+16 <= n; i += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i));
+    __m128i isNA = _mm_cmpeq_epi8(v, naC);
+    __m128i sign = _mm_cmplt_epi8(v, _mm_setzero_si128());
+    WidenShorts(dst+i, _mm_unpacklo_epi8(v, sign),
+      _mm_unpacklo_epi8(isNA, isNA));
+    WidenShorts(dst+i+8, _mm_unpackhi_epi8(v, sign),
+      _mm_unpackhi_epi8(isNA, isNA));
+  }
+  ToRValues<char, int>(src+i, n-i, dst+i, NA_C, NA_R);
+}
+#endif
+
+// Copy n values from R, storing NA_C for anything outside
+// [C_MIN, C_MAX] (which includes R's integer NA).
+template<typename CType, typename RType>
+inline void FromRValues( const RType *src, index_type n, CType *dst,
+  double NA_C, double C_MIN, double C_MAX )
+{
+  const CType naC = static_cast<CType>(NA_C);
+  index_type i;
+  for (i=0; i < n; ++i)
+  {
+    dst[i] = (src[i] < C_MIN || src[i] > C_MAX) ? naC :
+      static_cast<CType>(src[i]);
+  }
+}
+
+// Every int and double value fits, and the missing values agree.
+inline void FromRValues( const int *src, index_type n, int *dst,
+  double NA_C, double C_MIN, double C_MAX )
+{
+  memcpy(dst, src, n*sizeof(int));
+}
+
+inline void FromRValues( const double *src, index_type n, double *dst,
+  double NA_C, double C_MIN, double C_MAX )
+{
+  memcpy(dst, src, n*sizeof(double));
+}
+
+#if defined(__SSE2__)
+// Range check four ints at a time, blending in NA_C where they fail; the
+// signed saturating packs then narrow values that are already in range.
+inline __m128i ClampToNA( __m128i v, __m128i lo, __m128i hi, __m128i na )
+{
+  __m128i bad = _mm_or_si128(_mm_cmplt_epi32(v, lo), _mm_cmpgt_epi32(v, hi));
+  return _mm_or_si128(_mm_and_si128(bad, na), _mm_andnot_si128(bad, v));
+}
+
+inline void FromRValues( const int *src, index_type n, short *dst,
+  double NA_C, double C_MIN, double C_MAX )
+{
+  const __m128i lo = _mm_set1_epi32(static_cast<int>(C_MIN));
+  const __m128i hi = _mm_set1_epi32(static_cast<int>(C_MAX));
+  const __m128i na = _mm_set1_epi32(static_cast<int>(NA_C));
+  index_type i=0;
+  for (; i+8 <= n; i += 8)
+  {
+    const __m128i *p = reinterpret_cast<const __m128i*>(src+i);
+    __m128i a = ClampToNA(_mm_loadu_si128(p), lo, hi, na);
+    __m128i b = ClampToNA(_mm_loadu_si128(p+1), lo, hi, na);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i),
+      _mm_packs_epi32(a, b));
+  }
+  FromRValues<short, int>(src+i, n-i, dst+i, NA_C, C_MIN, C_MAX);
+}
+
+inline void FromRValues( const int *src, index_type n, char *dst,
+  double NA_C, double C_MIN, double C_MAX )
+{
+  const __m128i lo = _mm_set1_epi32(static_cast<int>(C_MIN));
+  const __m128i hi = _mm_set1_epi32(static_cast<int>(C_MAX));
+  const __m128i na = _mm_set1_epi32(static_cast<int>(NA_C));
+  index_type i=0;
+  for (; i+16 <= n; i += 16)
+  {
+    const __m128i *p = reinterpret_cast<const __m128i*>(src+i);
+    __m128i a = ClampToNA(_mm_loadu_si128(p), lo, hi, na);
+    __m128i b = ClampToNA(_mm_loadu_si128(p+1), lo, hi, na);
+    __m128i c = ClampToNA(_mm_loadu_si128(p+2), lo, hi, na);
+    __m128i d = ClampToNA(_mm_loadu_si128(p+3), lo, hi, na);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i),
+      _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+  }
+  FromRValues<char, int>(src+i, n-i, dst+i, NA_C, C_MIN, C_MAX);
+}
+
+inline void FromRValues( const double *src, index_type n, float *dst,
+  double NA_C, double C_MIN, double C_MAX )
+{
+  const __m128d lo = _mm_set1_pd(C_MIN);
+  const __m128d hi = _mm_set1_pd(C_MAX);
+  const __m128 na = _mm_set1_ps(static_cast<float>(NA_C));
+  index_type i=0;
+  for (; i+4 <= n; i += 4)
+  {
+    __m128d a = _mm_loadu_pd(src+i);
+    __m128d b = _mm_loadu_pd(src+i+2);
+    __m128d badA = _mm_or_pd(_mm_cmplt_pd(a, lo), _mm_cmpgt_pd(a, hi));
+    __m128d badB = _mm_or_pd(_mm_cmplt_pd(b, lo), _mm_cmpgt_pd(b, hi));
+    __m128 bad = _mm_shuffle_ps(_mm_castpd_ps(badA), _mm_castpd_ps(badB),
+      _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 v = _mm_movelh_ps(_mm_cvtpd_ps(a), _mm_cvtpd_ps(b));
+    _mm_storeu_ps(dst+i,
+      _mm_or_ps(_mm_and_ps(bad, na), _mm_andnot_ps(bad, v)));
+  }
+  FromRValues<float, double>(src+i, n-i, dst+i, NA_C, C_MIN, C_MAX);
+}
+#endif
+
+// Fill n elements from R values recycled from position offset, leaving
+// offset where the next fill should continue.  The values are copied a
+// run at a time, so there is no per-element modulo.
+template<typename CType, typename RType>
+inline void RecycledFromRValues( const RType *pVals, index_type valLength,
+  index_type &offset, CType *dst, index_type n, double NA_C, double C_MIN,
+  double C_MAX )
+{
+  if (valLength == 1)
+  {
+    CType val;
+    FromRValues(pVals, 1, &val, NA_C, C_MIN, C_MAX);
+    std::fill(dst, dst+n, val);
+    return;
+  }
+  while (n > 0)
+  {
+    index_type chunk = std::min(n, valLength - offset);
+    FromRValues(pVals + offset, chunk, dst, NA_C, C_MIN, C_MAX);
+    dst += chunk;
+    n -= chunk;
+    offset += chunk;
+    if (offset == valLength) offset = 0;
+  }
+}
+
+// A run of consecutive 1-based indices, stored 0-based.  A run of
+// missing indices has first == -1.
+struct IndexRun
+{
+  index_type first;
+  index_type length;
+};
+
+// Add the indices pIndices[0..n-1] to runs, extending the last run when
+// they continue it, so an index vector can be split a chunk at a time.
+inline void AppendIndexRuns( const double *pIndices, index_type n,
+  std::vector<IndexRun> &runs )
+{
+  index_type i=0;
+  while (i < n)
+  {
+    IndexRun run;
+    run.length = 1;
+    if (isna(pIndices[i]))
+    {
+      run.first = -1;
+      while (i+run.length < n && isna(pIndices[i+run.length]))
+      {
+        ++run.length;
+      }
+    }
+    else
+    {
+      run.first = static_cast<index_type>(pIndices[i]) - 1;
+      while (i+run.length < n &&
+        pIndices[i+run.length] == pIndices[i] + run.length)
+      {
+        ++run.length;
+      }
+    }
+    i += run.length;
+    if (!runs.empty())
+    {
+      IndexRun &last = runs.back();
+      if ((run.first < 0 && last.first < 0) ||
+        (run.first >= 0 && last.first >= 0 &&
+         last.first + last.length == run.first))
+      {
+        last.length += run.length;
+        continue;
+      }
+    }
+    runs.push_back(run);
+  }
+}
+
+// Split an index vector from R into runs of consecutive indices.
+inline void FindIndexRuns( const double *pIndices, index_type n,
+  std::vector<IndexRun> &runs )
+{
+  runs.clear();
+  AppendIndexRuns(pIndices, n, runs);
+}
+
+// Gather the elements of one column named by runs into dst.
+template<typename CType, typename RType>
+inline void RunsToRValues( const CType *pColumn,
+  const std::vector<IndexRun> &runs, RType *dst, double NA_C, double NA_R )
+{
+  std::vector<IndexRun>::const_iterator it;
+  for (it = runs.begin(); it != runs.end(); ++it)
+  {
+    if (it->first < 0)
+    {
+      std::fill(dst, dst + it->length, static_cast<RType>(NA_R));
+    }
+    else
+    {
+      ToRValues(pColumn + it->first, it->length, dst, NA_C, NA_R);
+    }
+    dst += it->length;
+  }
+}
+
+#endif // BIGMEMORY_ELEMENTKERNELS_HPP
@@ -0,0 +1,232 @@
+#ifndef BIGMEMORY_FILEIO_HPP
+#define BIGMEMORY_FILEIO_HPP
+
+// Large sequential file I/O for moving matrix data between files without
+// going through R.  Copies between files use copy_file_range on Linux,
+// so the kernel moves the data (or shares the extents, on file systems
+// that can) without it passing through user space; elsewhere they fall
+// back to pread/pwrite through a large buffer.  Clones first ask the file
+// system to share the extents outright (a reflink).
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef WINDOWS
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+#ifdef LINUX
+  #include <sys/syscall.h>
+  #include <sys/ioctl.h>
+  #include <linux/fs.h>
+#endif
+
+#include "bigmemoryDefines.h"
+
+#ifndef O_BINARY
+  #define O_BINARY 0
+#endif
+
+inline int OpenFile( const std::string &fileName, int flags )
+{
+  return open(fileName.c_str(), flags | O_BINARY, 0666);
+}
+
+inline void CloseFile( int fd )
+{
+  if (fd >= 0) close(fd);
+}
+
+// Closes its descriptor when it goes out of scope.  R errors unwind with
+// longjmp, so callers must leave the scope before raising one.
+class ScopedFile
+{
+  public:
+    explicit ScopedFile( int fd ) : _fd(fd) {}
+    ~ScopedFile() {CloseFile(_fd);}
+    int fd() const {return _fd;}
+
+  private:
+    ScopedFile( const ScopedFile& );
+    ScopedFile& operator=( const ScopedFile& );
+    int _fd;
+};
+
+// The size of the open file fd in bytes, or -1 if it can't be found.
+inline index_type FileSize( int fd )
+{
+#ifdef WINDOWS
+  struct _stati64 st;
+  if (_fstati64(fd, &st) != 0) return -1;
+#else
+  struct stat st;
+  if (fstat(fd, &st) != 0) return -1;
+#endif
+  return static_cast<index_type>(st.st_size);
+}
+
+// Read or write exactly len bytes at offset.
+inline bool ReadFully( int fd, char *buf, index_type len, index_type offset )
+{
+  while (len > 0)
+  {
+    // Some systems limit a single transfer to just under 2GB.
+    size_t chunk = static_cast<size_t>(
+      len < (static_cast<index_type>(1) << 30) ?
+        len : (static_cast<index_type>(1) << 30));
+#ifdef WINDOWS
+    if (_lseeki64(fd, offset, SEEK_SET) < 0) return false;
+    int n = _read(fd, buf, static_cast<unsigned int>(chunk));
+#else
+    ssize_t n = pread(fd, buf, chunk, static_cast<off_t>(offset));
+#endif
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    buf += n;
+    offset += n;
+    len -= n;
+  }
+  return true;
+}
+
+inline bool WriteFully( int fd, const char *buf, index_type len,
+  index_type offset )
+{
+  while (len > 0)
+  {
+    size_t chunk = static_cast<size_t>(
+      len < (static_cast<index_type>(1) << 30) ?
+        len : (static_cast<index_type>(1) << 30));
+#ifdef WINDOWS
+    if (_lseeki64(fd, offset, SEEK_SET) < 0) return false;
+    int n = _write(fd, buf, static_cast<unsigned int>(chunk));
+#else
+    ssize_t n = pwrite(fd, buf, chunk, static_cast<off_t>(offset));
+#endif
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    buf += n;
+    offset += n;
+    len -= n;
+  }
+  return true;
+}
+
+// Copy len bytes from inFd at inOffset to outFd at outOffset.
+inline bool CopyFileBytes( int inFd, index_type inOffset, int outFd,
+  index_type outOffset, index_type len )
+{
+#if defined(LINUX) && defined(SYS_copy_file_range)
+  while (len > 0)
+  {
+    loff_t inOff = static_cast<loff_t>(inOffset);
+    loff_t outOff = static_cast<loff_t>(outOffset);
+    long n = syscall(SYS_copy_file_range, inFd, &inOff, outFd, &outOff,
+      static_cast<size_t>(len < (static_cast<index_type>(1) << 30) ?
+        len : (static_cast<index_type>(1) << 30)), 0U);
+    if (n < 0 && errno == EINTR) continue;
+    // Older kernels, or a pair of files on different file systems, get
+    // the buffered copy below.
+    if (n <= 0) break;
+    inOffset += n;
+    outOffset += n;
+    len -= n;
+  }
+  if (len == 0) return true;
+#endif
+  const index_type bufSize = std::min(len,
+    static_cast<index_type>(1) << 23);
+  std::vector<char> buf(static_cast<std::size_t>(bufSize));
+  while (len > 0)
+  {
+    index_type n = std::min(len, bufSize);
+    if (!ReadFully(inFd, &buf[0], n, inOffset) ||
+        !WriteFully(outFd, &buf[0], n, outOffset))
+    {
+      return false;
+    }
+    inOffset += n;
+    outOffset += n;
+    len -= n;
+  }
+  return true;
+}
+
+// Copy len bytes as CopyFileBytes does, but let the two files share the
+// extents when the file system can (btrfs, XFS and others), which takes
+// time in proportion to the number of extents rather than the bytes.
+// Sharing needs the offsets, and the length unless the range ends at the
+// end of the input file, to be multiples of the file system block size;
+// anything else is copied.
+inline bool CloneFileBytes( int inFd, index_type inOffset, int outFd,
+  index_type outOffset, index_type len )
+{
+#if defined(LINUX) && defined(FICLONERANGE)
+  struct file_clone_range range;
+  range.src_fd = inFd;
+  range.src_offset = static_cast<uint64_t>(inOffset);
+  range.src_length = static_cast<uint64_t>(len);
+  range.dest_offset = static_cast<uint64_t>(outOffset);
+  if (len > 0 && ioctl(outFd, FICLONERANGE, &range) == 0) return true;
+#endif
+  return CopyFileBytes(inFd, inOffset, outFd, outOffset, len);
+}
+
+// Set the size of an open file, creating a sparse file where possible.
+inline bool ResizeFile( int fd, index_type size )
+{
+#ifdef WINDOWS
+  return 0 == _chsize_s(fd, size);
+#else
+  return 0 == ftruncate(fd, static_cast<off_t>(size));
+#endif
+}
+
+// Dimnames are stored as a count followed by length-prefixed strings.
+inline void AppendNamesBlock( std::string &block,
+  const std::vector<std::string> &names )
+{
+  int64_t count = static_cast<int64_t>(names.size());
+  block.append(reinterpret_cast<const char*>(&count), sizeof(count));
+  std::vector<std::string>::const_iterator it;
+  for (it = names.begin(); it != names.end(); ++it)
+  {
+    uint32_t len = static_cast<uint32_t>(it->size());
+    block.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    block.append(*it);
+  }
+}
+
+inline bool ReadNamesBlock( const std::string &block, std::size_t &pos,
+  std::vector<std::string> &names )
+{
+  int64_t count;
+  if (pos + sizeof(count) > block.size()) return false;
+  memcpy(&count, block.data() + pos, sizeof(count));
+  pos += sizeof(count);
+  if (count < 0) return false;
+  names.clear();
+  int64_t i;
+  for (i=0; i < count; ++i)
+  {
+    uint32_t len;
+    if (pos + sizeof(len) > block.size()) return false;
+    memcpy(&len, block.data() + pos, sizeof(len));
+    pos += sizeof(len);
+    if (pos + len > block.size()) return false;
+    names.push_back(block.substr(pos, len));
+    pos += len;
+  }
+  return true;
+}
+
+#endif // BIGMEMORY_FILEIO_HPP
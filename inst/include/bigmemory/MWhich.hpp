@@ -0,0 +1,493 @@
+#ifndef BIGMEMORY_MWHICH_HPP
+#define BIGMEMORY_MWHICH_HPP
+
+// The engine behind mwhich.  Each comparison is first rewritten as a
+// predicate on the matrix's own element type (a closed interval, a
+// not-equal test, or a NaN test), so that no element is ever converted to
+// double.  The rows are then taken a block at a time: every predicate is
+// evaluated over its column with SSE2 into a bitmap, one bit per row, and
+// the bitmaps are combined with AND or OR.  Under AND a column is only
+// read where rows are still selected, and under OR only where they are
+// not yet selected.  Row numbers are produced once, from the final bitmap.
+// A file-backed matrix may also carry a zone map, a min/max summary of
+// each block of each column, which lets whole blocks be settled without
+// reading them.
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+
+#include "bigmemoryDefines.h"
+#include "isna.hpp"
+#include "ZoneMap.h"
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+// Rows per block; the bitmap for a block is 8KB.  Blocks line up with
+// the blocks of a zone map.
+static const index_type MWHICH_BLOCK_ROWS = ZONE_MAP_BLOCK_ROWS;
+
+enum MWhichKind {PRED_NONE, PRED_ALL, PRED_RANGE, PRED_NOT_EQUAL,
+  PRED_IS_NAN, PRED_NOT_NAN};
+
+template<typename T>
+struct MWhichPredicate
+{
+  int kind;
+  T lo;
+  T hi;
+};
+
+inline int PopCount( uint64_t x )
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(x);
+#else
+  int n = 0;
+  for (; x; x &= x-1) ++n;
+  return n;
+#endif
+}
+
+inline int LowestBit( uint64_t x )
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#else
+  int n = 0;
+  for (; !(x & 1); x >>= 1) ++n;
+  return n;
+#endif
+}
+
+inline uint64_t LowBits( index_type n )
+{
+  return n >= 64 ? ~static_cast<uint64_t>(0) :
+    (static_cast<uint64_t>(1) << n) - 1;
+}
+
+// Only the floating point overloads are ever called; the template lets
+// MakeMWhichPredicate compile for the integer types.
+template<typename T>
+inline T NextToward( T v, bool up ) {return v;}
+
+inline float NextToward( float v, bool up )
+{
+  return nextafterf(v, up ? HUGE_VALF : -HUGE_VALF);
+}
+
+inline double NextToward( double v, bool up )
+{
+  return nextafter(v, up ? HUGE_VAL : -HUGE_VAL);
+}
+
+// The closest T to x that is >= x (or > x when strict) if up, or <= x
+// (< x) otherwise.  Returns false if there is none.
+template<typename T>
+bool FloatingBound( double x, bool strict, bool up, T &bound )
+{
+  const double tMax = static_cast<double>(std::numeric_limits<T>::max());
+  const T inf = std::numeric_limits<T>::infinity();
+  if (isna(x)) return false;
+  T t = x < -tMax ? -inf : (x > tMax ? inf : static_cast<T>(x));
+  while ( up ? (strict ? !(t > x) : !(t >= x)) :
+    (strict ? !(t < x) : !(t <= x)) )
+  {
+    if (t == (up ? inf : -inf)) return false;
+    t = NextToward(t, up);
+  }
+  bound = t;
+  return true;
+}
+
+// Rewrite one column's comparison, as passed from mwhich.internal, as a
+// predicate on T.  chkMin is 0 for >=, 1 for >, and -1 for 'neq'; chkMax
+// is 0 for <= and 1 for <.  A missing minV asks for the missing value
+// C_NA.  The integer types match their sentinel value like any other; for
+// float and double it is a NaN test, which for float also matches the
+// sentinel NA_FLOAT, carried in lo.
+template<typename T>
+MWhichPredicate<T> MakeMWhichPredicate( double minV, double maxV,
+  int chkMin, int chkMax, bool orOp, double C_NA )
+{
+  MWhichPredicate<T> pred;
+  pred.kind = PRED_NONE;
+  pred.lo = pred.hi = T();
+  if (std::numeric_limits<T>::is_integer)
+  {
+    if (isna(minV))
+    {
+      minV = maxV = static_cast<double>(static_cast<T>(C_NA));
+    }
+    const double tMin = static_cast<double>(std::numeric_limits<T>::min());
+    const double tMax = static_cast<double>(std::numeric_limits<T>::max());
+    if (chkMin == -1)
+    {
+      pred.kind = PRED_ALL;
+      if (minV == floor(minV) && minV >= tMin && minV <= tMax)
+      {
+        pred.kind = PRED_NOT_EQUAL;
+        pred.lo = static_cast<T>(minV);
+      }
+      return pred;
+    }
+    double lo = chkMin ? floor(minV) + 1 : ceil(minV);
+    double hi = chkMax ? ceil(maxV) - 1 : floor(maxV);
+    lo = std::max(lo, tMin);
+    hi = std::min(hi, tMax);
+    if (lo <= hi)
+    {
+      pred.kind = PRED_RANGE;
+      pred.lo = static_cast<T>(lo);
+      pred.hi = static_cast<T>(hi);
+    }
+    return pred;
+  }
+  if (chkMin == -1)
+  {
+    // An OR of 'neq NA' has always matched every row.
+    if (isna(minV))
+    {
+      pred.kind = orOp ? PRED_ALL : PRED_NOT_NAN;
+      pred.lo = static_cast<T>(C_NA);
+    }
+    else if (!FloatingBound<T>(minV, false, true, pred.lo) ||
+      static_cast<double>(pred.lo) != minV)
+    {
+      pred.kind = PRED_ALL;
+    }
+    else
+    {
+      pred.kind = PRED_NOT_EQUAL;
+    }
+    return pred;
+  }
+  if (isna(minV))
+  {
+    pred.kind = PRED_IS_NAN;
+    pred.lo = static_cast<T>(C_NA);
+  }
+  else if (FloatingBound<T>(minV, chkMin != 0, true, pred.lo) &&
+    FloatingBound<T>(maxV, chkMax != 0, false, pred.hi) && pred.lo <= pred.hi)
+  {
+    pred.kind = PRED_RANGE;
+  }
+  return pred;
+}
+
+template<typename T>
+inline bool MWhichTest( const T val, const MWhichPredicate<T> &pred )
+{
+  switch (pred.kind)
+  {
+    case PRED_RANGE: return val >= pred.lo && val <= pred.hi;
+    case PRED_NOT_EQUAL: return !(val == pred.lo);
+    case PRED_IS_NAN: return val != val || val == pred.lo;
+    case PRED_NOT_NAN: return val == val && !(val == pred.lo);
+    case PRED_ALL: return true;
+  }
+  return false;
+}
+
+// Bit i of the result is set if p[i] satisfies pred, for i < n <= 64.
+template<typename T>
+inline uint64_t MWhichWordScalar( const T *p, index_type n,
+  const MWhichPredicate<T> &pred )
+{
+  uint64_t bits = 0;
+  index_type i;
+  for (i=0; i < n; ++i)
+  {
+    bits |= static_cast<uint64_t>(MWhichTest(p[i], pred)) << i;
+  }
+  return bits;
+}
+
+#if defined(__SSE2__)
+// One SSE2 register's worth of tests for each element type; each returns
+// a bit per lane.
+template<typename T>
+struct MWhichLanes;
+
+template<>
+struct MWhichLanes<char>
+{
+  static const int width = 16;
+  static int range( const char *p, char lo, char hi )
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i out = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(lo)),
+      _mm_cmpgt_epi8(v, _mm_set1_epi8(hi)));
+    return ~_mm_movemask_epi8(out) & 0xFFFF;
+  }
+  static int equal( const char *p, char x )
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(x)));
+  }
+  static int nan( const char *p ) {return 0;}
+};
+
+template<>
+struct MWhichLanes<short>
+{
+  static const int width = 8;
+  static int bits( __m128i m )
+  {
+    return _mm_movemask_epi8(_mm_packs_epi16(m, m)) & 0xFF;
+  }
+  static int range( const short *p, short lo, short hi )
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i out = _mm_or_si128(_mm_cmplt_epi16(v, _mm_set1_epi16(lo)),
+      _mm_cmpgt_epi16(v, _mm_set1_epi16(hi)));
+    return ~bits(out) & 0xFF;
+  }
+  static int equal( const short *p, short x )
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return bits(_mm_cmpeq_epi16(v, _mm_set1_epi16(x)));
+  }
+  static int nan( const short *p ) {return 0;}
+};
+
+template<>
+struct MWhichLanes<int>
+{
+  static const int width = 4;
+  static int bits( __m128i m )
+  {
+    return _mm_movemask_ps(_mm_castsi128_ps(m));
+  }
+  static int range( const int *p, int lo, int hi )
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i out = _mm_or_si128(_mm_cmplt_epi32(v, _mm_set1_epi32(lo)),
+      _mm_cmpgt_epi32(v, _mm_set1_epi32(hi)));
+    return ~bits(out) & 0xF;
+  }
+  static int equal( const int *p, int x )
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return bits(_mm_cmpeq_epi32(v, _mm_set1_epi32(x)));
+  }
+  static int nan( const int *p ) {return 0;}
+};
+
+template<>
+struct MWhichLanes<float>
+{
+  static const int width = 4;
+  static int range( const float *p, float lo, float hi )
+  {
+    __m128 v = _mm_loadu_ps(p);
+    return _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(v, _mm_set1_ps(lo)),
+      _mm_cmple_ps(v, _mm_set1_ps(hi))));
+  }
+  static int equal( const float *p, float x )
+  {
+    return _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(p), _mm_set1_ps(x)));
+  }
+  static int nan( const float *p )
+  {
+    __m128 v = _mm_loadu_ps(p);
+    return _mm_movemask_ps(_mm_cmpunord_ps(v, v));
+  }
+};
+
+template<>
+struct MWhichLanes<double>
+{
+  static const int width = 2;
+  static int range( const double *p, double lo, double hi )
+  {
+    __m128d v = _mm_loadu_pd(p);
+    return _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(v, _mm_set1_pd(lo)),
+      _mm_cmple_pd(v, _mm_set1_pd(hi))));
+  }
+  static int equal( const double *p, double x )
+  {
+    return _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(p), _mm_set1_pd(x)));
+  }
+  static int nan( const double *p )
+  {
+    __m128d v = _mm_loadu_pd(p);
+    return _mm_movemask_pd(_mm_cmpunord_pd(v, v));
+  }
+};
+#endif
+
+template<typename T>
+inline uint64_t MWhichWord( const T *p, index_type n,
+  const MWhichPredicate<T> &pred )
+{
+  if (pred.kind == PRED_NONE) return 0;
+  if (pred.kind == PRED_ALL) return LowBits(n);
+#if defined(__SSE2__)
+  if (n == 64)
+  {
+    typedef MWhichLanes<T> L;
+    uint64_t bits = 0;
+    int i;
+    switch (pred.kind)
+    {
+      case PRED_RANGE:
+        for (i=0; i < 64; i += L::width)
+          bits |= static_cast<uint64_t>(L::range(p+i, pred.lo, pred.hi)) << i;
+        return bits;
+      case PRED_NOT_EQUAL:
+        for (i=0; i < 64; i += L::width)
+          bits |= static_cast<uint64_t>(L::equal(p+i, pred.lo)) << i;
+        return ~bits;
+      case PRED_IS_NAN:
+      case PRED_NOT_NAN:
+        for (i=0; i < 64; i += L::width)
+          bits |= static_cast<uint64_t>(L::nan(p+i) | L::equal(p+i, pred.lo))
+            << i;
+        return pred.kind == PRED_IS_NAN ? bits : ~bits;
+    }
+  }
+#endif
+  return MWhichWordScalar(p, n, pred);
+}
+
+// Summarize the n values of a block for its zone map.
+template<typename T>
+void SummarizeZone( const T *p, index_type n, ZoneBlock &zone )
+{
+  T lo = T(), hi = T();
+  bool any = false;
+  int64_t naCount = 0;
+  index_type i;
+  for (i=0; i < n; ++i)
+  {
+    if (p[i] != p[i])
+    {
+      ++naCount;
+    }
+    else if (!any)
+    {
+      lo = hi = p[i];
+      any = true;
+    }
+    else
+    {
+      if (p[i] < lo) lo = p[i];
+      if (hi < p[i]) hi = p[i];
+    }
+  }
+  zone.min = any ? static_cast<double>(lo) : 1;
+  zone.max = any ? static_cast<double>(hi) : 0;
+  zone.naCount = naCount;
+}
+
+// What pred does to a block of n rows, judging from its zone: PRED_NONE
+// or PRED_ALL when the zone settles every row, and pred.kind otherwise.
+template<typename T>
+int ZoneStatus( const MWhichPredicate<T> &pred, const ZoneBlock &zone,
+  index_type n )
+{
+  const bool allNaN = zone.min > zone.max;
+  const bool noNaN = zone.naCount == 0;
+  const double lo = static_cast<double>(pred.lo);
+  const double hi = static_cast<double>(pred.hi);
+  // For the NaN tests, whether the block can hold the sentinel in lo.
+  const bool noSentinel = allNaN || !(lo >= zone.min && lo <= zone.max);
+  switch (pred.kind)
+  {
+    case PRED_RANGE:
+      if (allNaN || zone.max < lo || zone.min > hi) return PRED_NONE;
+      if (noNaN && zone.min >= lo && zone.max <= hi) return PRED_ALL;
+      break;
+    case PRED_NOT_EQUAL:
+      if (allNaN || lo < zone.min || lo > zone.max) return PRED_ALL;
+      if (noNaN && zone.min == lo && zone.max == lo) return PRED_NONE;
+      break;
+    case PRED_IS_NAN:
+      if (noNaN && noSentinel) return PRED_NONE;
+      if (zone.naCount == n) return PRED_ALL;
+      break;
+    case PRED_NOT_NAN:
+      if (noNaN && noSentinel) return PRED_ALL;
+      if (zone.naCount == n) return PRED_NONE;
+      break;
+  }
+  return pred.kind;
+}
+
+// Select the rows [firstRow, firstRow+numRows) satisfying the predicates
+// on columns cols (0-based), combined with AND or OR.  Row firstRow+i is
+// bit i%64 of sel[i/64].
+template<typename T, typename MatrixType>
+void MWhichBlock( MatrixType mat, const std::vector<index_type> &cols,
+  const std::vector< MWhichPredicate<T> > &preds, bool orOp,
+  index_type firstRow, index_type numRows, uint64_t *sel )
+{
+  const index_type numWords = (numRows + 63) / 64;
+  index_type w;
+  for (w=0; w < numWords; ++w)
+  {
+    sel[w] = orOp ? 0 : LowBits(numRows - w*64);
+  }
+  std::size_t j;
+  for (j=0; j < preds.size(); ++j)
+  {
+    const T *pColumn = mat[cols[j]] + firstRow;
+    bool any = false;
+    for (w=0; w < numWords; ++w)
+    {
+      index_type n = std::min(static_cast<index_type>(64), numRows - w*64);
+      if (orOp)
+      {
+        if (sel[w] != LowBits(n))
+        {
+          sel[w] |= MWhichWord(pColumn + w*64, n, preds[j]);
+          any = any || sel[w] != LowBits(n);
+        }
+      }
+      else if (sel[w])
+      {
+        sel[w] &= MWhichWord(pColumn + w*64, n, preds[j]);
+        any = any || sel[w];
+      }
+    }
+    // Nothing left to decide in this block.
+    if (!any) break;
+  }
+}
+
+// Write the 1-based row numbers selected in a block's bitmap.
+inline double* MWhichRowNumbers( const uint64_t *sel, index_type numRows,
+  index_type firstRow, double *out )
+{
+  const index_type numWords = (numRows + 63) / 64;
+  index_type w;
+  for (w=0; w < numWords; ++w)
+  {
+    uint64_t bits = sel[w];
+    while (bits)
+    {
+      *out++ = static_cast<double>(firstRow + w*64 + LowestBit(bits) + 1);
+      bits &= bits - 1;
+    }
+  }
+  return out;
+}
+
+inline index_type MWhichCount( const uint64_t *sel, index_type numRows )
+{
+  const index_type numWords = (numRows + 63) / 64;
+  index_type count = 0;
+  index_type w;
+  for (w=0; w < numWords; ++w)
+  {
+    count += PopCount(sel[w]);
+  }
+  return count;
+}
+
+#endif // BIGMEMORY_MWHICH_HPP
@@ -0,0 +1,143 @@
+#ifndef BIGMEMORY_PERMUTEINPLACE_HPP
+#define BIGMEMORY_PERMUTEINPLACE_HPP
+
+// The engine behind mpermute and mpermuteCols.  An order vector (1-based,
+// as R passes it) that is a permutation is applied in place by following
+// its cycles: the first element of a cycle is set aside, every other
+// element is moved once into the slot that wants it, and the element set
+// aside closes the cycle.  Rows are moved for a block of columns at a time
+// and columns are moved a block of rows at a time, so the extra memory is
+// a block of values plus one bit per row (or column) to mark the cycles
+// already followed.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "bigmemoryDefines.h"
+
+#if defined(__GNUC__)
+#define BIGMEMORY_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define BIGMEMORY_PREFETCH(p)
+#endif
+
+// The number of columns whose rows are moved together on each walk of a
+// cycle.
+const index_type PERMUTE_BLOCK_COLS = 8;
+// The number of rows of each column moved at a time when permuting columns.
+const index_type PERMUTE_BLOCK_ROWS = 65536;
+
+// Whether pov[0..n-1] holds each of 1..n exactly once.  Leaves every bit
+// of seen set if it does.
+inline bool IsPermutation( const double *pov, const index_type n,
+  std::vector<bool> &seen )
+{
+  seen.assign(n, false);
+  index_type i, k;
+  for (i=0; i < n; ++i)
+  {
+    k = static_cast<index_type>(pov[i]) - 1;
+    if (k < 0 || k >= n || seen[k]) return false;
+    seen[k] = true;
+  }
+  return true;
+}
+
+// Apply the permutation pov to the rows of columns [firstCol, lastCol) of
+// m, so that row j ends up holding what was in row pov[j].  done must hold
+// nrow bits; it is overwritten.
+template<typename MatrixAccessorType>
+void PermuteRowsInPlace( MatrixAccessorType &m, const double *pov,
+  const index_type firstCol, const index_type lastCol,
+  std::vector<bool> &done )
+{
+  typedef typename MatrixAccessorType::value_type ValueType;
+  const index_type n = m.nrow();
+  ValueType *cols[PERMUTE_BLOCK_COLS];
+  ValueType held[PERMUTE_BLOCK_COLS];
+  index_type c0, c, nc, s, j, k, next;
+  for (c0=firstCol; c0 < lastCol; c0 += PERMUTE_BLOCK_COLS)
+  {
+    nc = std::min(PERMUTE_BLOCK_COLS, lastCol-c0);
+    for (c=0; c < nc; ++c)
+    {
+      cols[c] = m[c0+c];
+    }
+    done.assign(n, false);
+    for (s=0; s < n; ++s)
+    {
+      if (done[s]) continue;
+      done[s] = true;
+      k = static_cast<index_type>(pov[s]) - 1;
+      if (k == s) continue;
+      for (c=0; c < nc; ++c)
+      {
+        held[c] = cols[c][s];
+      }
+      j = s;
+      while (k != s)
+      {
+        // The row after this one is known as soon as k is, so start
+        // fetching it while this one is moved.
+        next = static_cast<index_type>(pov[k]) - 1;
+        for (c=0; c < nc; ++c)
+        {
+          BIGMEMORY_PREFETCH(cols[c] + next);
+        }
+        for (c=0; c < nc; ++c)
+        {
+          cols[c][j] = cols[c][k];
+        }
+        done[k] = true;
+        j = k;
+        k = next;
+      }
+      for (c=0; c < nc; ++c)
+      {
+        cols[c][j] = held[c];
+      }
+    }
+  }
+}
+
+// Apply the permutation pov to the columns of m over rows [0, numRows), so
+// that column j ends up holding what was in column pov[j].  Each cycle
+// moves whole runs of rows with memcpy.
+template<typename MatrixAccessorType>
+void PermuteColumnsInPlace( MatrixAccessorType &m, const double *pov,
+  const index_type numRows )
+{
+  typedef typename MatrixAccessorType::value_type ValueType;
+  const index_type n = m.ncol();
+  const index_type blockRows = std::min(PERMUTE_BLOCK_ROWS, numRows);
+  if (n == 0 || blockRows == 0) return;
+  std::vector<ValueType> held(blockRows);
+  std::vector<bool> done;
+  index_type r0, nr, s, j, k;
+  for (r0=0; r0 < numRows; r0 += blockRows)
+  {
+    nr = std::min(blockRows, numRows-r0);
+    const size_t bytes = nr*sizeof(ValueType);
+    done.assign(n, false);
+    for (s=0; s < n; ++s)
+    {
+      if (done[s]) continue;
+      done[s] = true;
+      k = static_cast<index_type>(pov[s]) - 1;
+      if (k == s) continue;
+      memcpy(&held[0], m[s] + r0, bytes);
+      j = s;
+      while (k != s)
+      {
+        memcpy(m[j] + r0, m[k] + r0, bytes);
+        done[k] = true;
+        j = k;
+        k = static_cast<index_type>(pov[k]) - 1;
+      }
+      memcpy(m[j] + r0, &held[0], bytes);
+    }
+  }
+}
+
+#endif // BIGMEMORY_PERMUTEINPLACE_HPP
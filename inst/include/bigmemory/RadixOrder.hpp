@@ -0,0 +1,433 @@
+#ifndef BIGMEMORY_RADIXORDER_HPP
+#define BIGMEMORY_RADIXORDER_HPP
+
+// The engine behind morder and morderCols.  The order is a permutation of
+// row (or column) numbers, held as 32-bit integers whenever they fit, and
+// each key is applied with a stable LSD radix sort, last key first, so the
+// whole order costs a fixed number of linear passes per key.  Each key is
+// turned into an unsigned integer that sorts the same way (flipping the
+// sign bit of integers, and the sign bit or all bits of floating point
+// values), and missing values are set aside before the sort and put back
+// at the start or the end afterwards.
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <stdint.h>
+
+#include "bigmemoryDefines.h"
+#include "isna.hpp"
+
+template<typename T>
+struct RadixKey;
+
+template<>
+struct RadixKey<char>
+{
+  typedef uint8_t type;
+  static type encode( char v )
+  {
+    return static_cast<type>(v) ^
+      (std::numeric_limits<char>::is_signed ? 0x80 : 0);
+  }
+};
+
+template<>
+struct RadixKey<short>
+{
+  typedef uint16_t type;
+  static type encode( short v ) {return static_cast<type>(v) ^ 0x8000;}
+};
+
+template<>
+struct RadixKey<int>
+{
+  typedef uint32_t type;
+  static type encode( int v ) {return static_cast<type>(v) ^ 0x80000000u;}
+};
+
+// Negative values have all their bits flipped so that larger magnitudes
+// come first; non-negative ones only their sign bit.  -0 is taken as 0,
+// so that the two stay in their original order.
+template<>
+struct RadixKey<float>
+{
+  typedef uint32_t type;
+  static type encode( float v )
+  {
+    if (v == 0) v = 0;
+    type u;
+    memcpy(&u, &v, sizeof(u));
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+  }
+};
+
+template<>
+struct RadixKey<double>
+{
+  typedef uint64_t type;
+  static type encode( double v )
+  {
+    if (v == 0) v = 0;
+    type u;
+    memcpy(&u, &v, sizeof(u));
+    const type sign = static_cast<type>(1) << 63;
+    return (u & sign) ? ~u : (u | sign);
+  }
+};
+
+// The keys of one column: key(i) is the value in row i.
+template<typename T>
+struct ColumnKey
+{
+  typedef T value_type;
+  ColumnKey( const T *p ) : _p(p) {}
+  T operator()( index_type i ) const {return _p[i];}
+  const T *_p;
+};
+
+// The keys of one row: key(j) is the value in column j.
+template<typename MatrixAccessorType>
+struct RowKey
+{
+  typedef typename MatrixAccessorType::value_type value_type;
+  RowKey( MatrixAccessorType m, index_type row ) : _m(m), _row(row) {}
+  value_type operator()( index_type j ) const {return _m[j][_row];}
+  mutable MatrixAccessorType _m;
+  index_type _row;
+};
+
+// Drop the entries of perm whose key is missing, keeping the others in
+// order.
+template<typename IndexT, typename KeyFunc>
+void RadixDropNA( std::vector<IndexT> &perm, const KeyFunc &key )
+{
+  std::size_t i, j=0;
+  for (i=0; i < perm.size(); ++i)
+  {
+    if (!isna(key(perm[i]))) perm[j++] = perm[i];
+  }
+  perm.resize(j);
+}
+
+// Stably sort keys[0, n), and perm with them, on the digits (bytes)
+// below numDigits, skipping digits that are the same for every key.  The
+// buffers must hold n elements.
+template<typename U, typename IndexT>
+void RadixSortRange( U *keys, IndexT *perm, index_type n, int numDigits,
+  U *keyBuf, IndexT *permBuf )
+{
+  if (n < 2 || numDigits == 0) return;
+  std::vector<index_type> counts(numDigits*256, 0);
+  index_type i;
+  int d;
+  for (i=0; i < n; ++i)
+  {
+    for (d=0; d < numDigits; ++d)
+    {
+      ++counts[d*256 + ((keys[i] >> (8*d)) & 0xff)];
+    }
+  }
+  U *pKeys = keys, *pKeyBuf = keyBuf;
+  IndexT *pPerm = perm, *pPermBuf = permBuf;
+  for (d=0; d < numDigits; ++d)
+  {
+    index_type *pCounts = &counts[d*256];
+    if (pCounts[(pKeys[0] >> (8*d)) & 0xff] == n) continue;
+    index_type offsets[256];
+    index_type sum = 0;
+    int b;
+    for (b=0; b < 256; ++b)
+    {
+      offsets[b] = sum;
+      sum += pCounts[b];
+    }
+    for (i=0; i < n; ++i)
+    {
+      index_type pos = offsets[(pKeys[i] >> (8*d)) & 0xff]++;
+      pKeyBuf[pos] = pKeys[i];
+      pPermBuf[pos] = pPerm[i];
+    }
+    std::swap(pKeys, pKeyBuf);
+    std::swap(pPerm, pPermBuf);
+  }
+  if (pKeys != keys)
+  {
+    std::copy(pKeys, pKeys + n, keys);
+    std::copy(pPerm, pPerm + n, perm);
+  }
+}
+
+// Stably sort perm by key(perm[i]), decreasing if asked, with the
+// indices of missing values placed last if naLast and first otherwise.
+template<typename IndexT, typename KeyFunc>
+void RadixOrderBy( std::vector<IndexT> &perm, const KeyFunc &key,
+  bool decreasing, bool naLast )
+{
+  typedef typename KeyFunc::value_type T;
+  typedef typename RadixKey<T>::type U;
+  const U flip = decreasing ? static_cast<U>(~static_cast<U>(0)) : 0;
+
+  // Set the missing values aside, and encode the rest.
+  std::vector<IndexT> nas;
+  std::vector<U> keys;
+  keys.reserve(perm.size());
+  std::size_t i, n=0;
+  for (i=0; i < perm.size(); ++i)
+  {
+    T v = key(perm[i]);
+    if (isna(v))
+    {
+      nas.push_back(perm[i]);
+    }
+    else
+    {
+      perm[n++] = perm[i];
+      keys.push_back(RadixKey<T>::encode(v) ^ flip);
+    }
+  }
+  perm.resize(n);
+  if (n > 1)
+  {
+    std::vector<U> keyBuf(n);
+    std::vector<IndexT> permBuf(n);
+    RadixSortRange(&keys[0], &perm[0], static_cast<index_type>(n),
+      static_cast<int>(sizeof(U)), &keyBuf[0], &permBuf[0]);
+  }
+  perm.insert(naLast ? perm.end() : perm.begin(), nas.begin(), nas.end());
+}
+
+// Lexicographic comparison on keys[first, keys.size()), with missing
+// values first or last; used for small groups of ties.
+template<typename KeyFunc>
+struct RadixTieLess
+{
+  RadixTieLess( const std::vector<KeyFunc> &keys, std::size_t first,
+    bool decreasing, bool naLast ) : _keys(keys), _first(first),
+    _decreasing(decreasing), _naLast(naLast) {}
+
+  template<typename IndexT>
+  bool operator()( IndexT a, IndexT b ) const
+  {
+    std::size_t k;
+    for (k=_first; k < _keys.size(); ++k)
+    {
+      typename KeyFunc::value_type x = _keys[k](a), y = _keys[k](b);
+      bool naX = isna(x), naY = isna(y);
+      if (naX || naY)
+      {
+        if (naX && naY) continue;
+        return _naLast ? naY : naX;
+      }
+      if (x < y) return !_decreasing;
+      if (y < x) return _decreasing;
+    }
+    return false;
+  }
+
+  const std::vector<KeyFunc> &_keys;
+  std::size_t _first;
+  bool _decreasing, _naLast;
+};
+
+// Put a group of entries that tie on keys[0] in order by the other keys.
+template<typename IndexT, typename KeyFunc>
+void RadixRefineTies( IndexT *perm, index_type n,
+  const std::vector<KeyFunc> &keys, bool decreasing, bool naLast )
+{
+  if (n < 2 || keys.size() < 2) return;
+  if (n <= 64)
+  {
+    std::stable_sort(perm, perm + n, 
+      RadixTieLess<KeyFunc>(keys, 1, decreasing, naLast));
+    return;
+  }
+  std::vector<IndexT> group(perm, perm + n);
+  int k;
+  for (k=static_cast<int>(keys.size())-1; k >= 1; --k)
+  {
+    RadixOrderBy(group, keys[k], decreasing, naLast);
+  }
+  std::copy(group.begin(), group.end(), perm);
+}
+
+// The parallel version of applying RadixOrderBy to every key, last key
+// first.  The first key is encoded, partitioned on its most significant
+// varying byte, and the 256 parts are sorted on the bytes below it at
+// the same time.  Only runs of entries that tie on the first key are then
+// ordered by the other keys, again many runs at a time.
+template<typename IndexT, typename KeyFunc>
+void ParallelRadixOrder( std::vector<IndexT> &perm,
+  const std::vector<KeyFunc> &keyFuncs, bool decreasing, bool naLast,
+  int numThreads )
+{
+  typedef typename KeyFunc::value_type T;
+  typedef typename RadixKey<T>::type U;
+  const int numDigits = sizeof(U);
+  const U flip = decreasing ? static_cast<U>(~static_cast<U>(0)) : 0;
+  const KeyFunc &key = keyFuncs[0];
+  const index_type total = static_cast<index_type>(perm.size());
+  const index_type numChunks = std::max(1, numThreads);
+  const index_type chunkSize = (total + numChunks - 1) / numChunks;
+  index_type c;
+  int d;
+
+  // Count, per chunk, the missing values and every digit of the others.
+  std::vector<index_type> naCounts(numChunks+1, 0);
+  std::vector<index_type> counts(numChunks*numDigits*256, 0);
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(static)
+#endif
+  for (c=0; c < numChunks; ++c)
+  {
+    index_type *pCounts = &counts[c*numDigits*256];
+    index_type i, end = std::min(total, (c+1)*chunkSize);
+    for (i=c*chunkSize; i < end; ++i)
+    {
+      T v = key(perm[i]);
+      if (isna(v))
+      {
+        ++naCounts[c+1];
+        continue;
+      }
+      U u = RadixKey<T>::encode(v) ^ flip;
+      int j;
+      for (j=0; j < numDigits; ++j)
+      {
+        ++pCounts[j*256 + ((u >> (8*j)) & 0xff)];
+      }
+    }
+  }
+  for (c=0; c < numChunks; ++c)
+  {
+    naCounts[c+1] += naCounts[c];
+  }
+  const index_type numNA = naCounts[numChunks];
+  const index_type n = total - numNA;
+
+  // The most significant digit on which the keys differ.
+  std::vector<index_type> digitCounts(numDigits*256, 0);
+  for (c=0; c < numChunks; ++c)
+  {
+    index_type b;
+    for (b=0; b < numDigits*256; ++b)
+    {
+      digitCounts[b] += counts[c*numDigits*256 + b];
+    }
+  }
+  int top = -1;
+  for (d=numDigits-1; d >= 0 && top < 0; --d)
+  {
+    int b;
+    for (b=0; b < 256; ++b)
+    {
+      if (digitCounts[d*256+b] != 0 && digitCounts[d*256+b] != n) top = d;
+    }
+  }
+
+  // Scatter on that digit (or just set the missing values aside), chunk by
+  // chunk so that the order within each part is kept.
+  std::vector<index_type> bucketStarts(257, 0);
+  std::vector<index_type> offsets(numChunks*256, 0);
+  if (top >= 0)
+  {
+    int b;
+    for (b=0; b < 256; ++b)
+    {
+      bucketStarts[b+1] = bucketStarts[b] + digitCounts[top*256+b];
+      index_type sum = bucketStarts[b];
+      for (c=0; c < numChunks; ++c)
+      {
+        offsets[c*256+b] = sum;
+        sum += counts[c*numDigits*256 + top*256 + b];
+      }
+    }
+  }
+  else
+  {
+    bucketStarts[1] = n;
+    for (c=0; c < numChunks; ++c)
+    {
+      offsets[c*256] = (c*chunkSize < total ? c*chunkSize : total) - 
+        naCounts[c];
+    }
+  }
+  std::vector<U> keys(n), keyBuf(n);
+  std::vector<IndexT> sorted(total), permBuf(n);
+  const index_type naStart = naLast ? n : 0;
+  const index_type dataStart = naLast ? 0 : numNA;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(static)
+#endif
+  for (c=0; c < numChunks; ++c)
+  {
+    index_type *pOffsets = &offsets[c*256];
+    index_type naPos = naStart + naCounts[c];
+    index_type i, end = std::min(total, (c+1)*chunkSize);
+    for (i=c*chunkSize; i < end; ++i)
+    {
+      T v = key(perm[i]);
+      if (isna(v))
+      {
+        sorted[naPos++] = perm[i];
+        continue;
+      }
+      U u = RadixKey<T>::encode(v) ^ flip;
+      index_type pos = pOffsets[top >= 0 ? ((u >> (8*top)) & 0xff) : 0]++;
+      keys[pos] = u;
+      permBuf[pos] = perm[i];
+    }
+  }
+
+  // Sort each part on the lower digits.
+  index_type b;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+#endif
+  for (b=0; b < 256; ++b)
+  {
+    index_type first = bucketStarts[b];
+    index_type len = bucketStarts[b+1] - first;
+    if (len > 1 && top > 0)
+    {
+      RadixSortRange(&keys[first], &permBuf[first], len, top,
+        &keyBuf[first], &sorted[dataStart + first]);
+    }
+  }
+  std::copy(permBuf.begin(), permBuf.end(), sorted.begin() + dataStart);
+  perm.swap(sorted);
+  if (keyFuncs.size() < 2) return;
+
+  // Order the runs of ties on the first key by the other keys; the
+  // missing values form one more run.  Each segment takes the runs that
+  // start in it.
+  std::vector<U>().swap(keyBuf);
+  std::vector<IndexT>().swap(permBuf);
+  const index_type numSegments = numChunks * 8;
+  const index_type segSize = (n + numSegments - 1) / numSegments;
+  IndexT *pData = perm.empty() ? NULL : &perm[dataStart];
+  index_type s;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+#endif
+  for (s=0; s < numSegments; ++s)
+  {
+    index_type i = s*segSize, end = std::min(n, (s+1)*segSize);
+    if (i >= end) continue;
+    while (i > 0 && i < end && keys[i] == keys[i-1]) ++i;
+    while (i < end)
+    {
+      index_type j = i+1;
+      while (j < n && keys[j] == keys[i]) ++j;
+      RadixRefineTies(pData + i, j - i, keyFuncs, decreasing, naLast);
+      i = j;
+    }
+  }
+  if (numNA > 1)
+  {
+    RadixRefineTies(&perm[naStart], numNA, keyFuncs, decreasing, naLast);
+  }
+}
+
+#endif // BIGMEMORY_RADIXORDER_HPP
@@ -0,0 +1,406 @@
+#ifndef BIGMEMORY_TEXTFILE_HPP
+#define BIGMEMORY_TEXTFILE_HPP
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "bigmemoryDefines.h"
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+// AVX2 is selected at run time, so the package does not have to be built
+// with -mavx2 to use it.
+#if defined(__x86_64__) && defined(__GNUC__) && \
+  (defined(__clang__) || __GNUC__ > 4 || \
+  (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+  #include <immintrin.h>
+  #define BIGMEMORY_RUNTIME_AVX2
+#endif
+
+// A read-only mapping of a delimited text file.  The ingest code works
+// directly on the mapped bytes instead of going through getline, which
+// lets several threads parse disjoint parts of the file at once.
+class MappedTextFile
+{
+  public:
+    MappedTextFile() : _begin(NULL), _end(NULL) {}
+
+    bool open( const std::string &fileName )
+    {
+      using namespace boost::interprocess;
+      std::ifstream probe(fileName.c_str(),
+        std::ios::in | std::ios::binary | std::ios::ate);
+      if (!probe.is_open())
+      {
+        return false;
+      }
+      std::streamoff fileSize = probe.tellg();
+      probe.close();
+      if (fileSize <= 0)
+      {
+        // Mapping an empty file is an error, but an empty file is
+        // simply one with no lines in it.
+        _begin = _end = NULL;
+        return true;
+      }
+      try
+      {
+        file_mapping mFile(fileName.c_str(), read_only);
+        mapped_region(mFile, read_only).swap(_region);
+      }
+      catch(boost::interprocess::interprocess_exception &e)
+      {
+        return false;
+      }
+      _begin = reinterpret_cast<const char*>(_region.get_address());
+      _end = _begin + _region.get_size();
+      _region.advise(mapped_region::advice_sequential);
+      return true;
+    }
+
+    const char* begin() const {return _begin;}
+    const char* end() const {return _end;}
+    index_type size() const {return static_cast<index_type>(_end - _begin);}
+
+  private:
+    boost::interprocess::mapped_region _region;
+    const char *_begin;
+    const char *_end;
+};
+
+// Newline counting is the whole cost of the pre-scan that sizes a
+// matrix before it is read, so it is done 16 or 32 bytes at a time.
+// Matches are accumulated in per-byte counters and folded into 64-bit
+// sums with psadbw before the byte counters can overflow.
+inline index_type CountNewlinesScalar( const char *begin, const char *end )
+{
+  index_type count = 0;
+  for (const char *p = begin; p < end; ++p)
+  {
+    count += ('\n' == *p);
+  }
+  return count;
+}
+
+#if defined(__SSE2__)
+inline index_type CountNewlinesSSE2( const char *begin, const char *end )
+{
+  index_type count = 0;
+  const char *p = begin;
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i zero = _mm_setzero_si128();
+  while (end - p >= 16)
+  {
+    __m128i acc = _mm_setzero_si128();
+    int i;
+    for (i=0; i < 255 && end - p >= 16; ++i, p += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, newline));
+    }
+    __m128i sums = _mm_sad_epu8(acc, zero);
+    count += _mm_cvtsi128_si32(sums) + 
+      _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+  }
+  return count + CountNewlinesScalar(p, end);
+}
+#endif
+
+#if defined(BIGMEMORY_RUNTIME_AVX2)
+__attribute__((target("avx2")))
+inline index_type CountNewlinesAVX2( const char *begin, const char *end )
+{
+  index_type count = 0;
+  const char *p = begin;
+  const __m256i newline = _mm256_set1_epi8('\n');
+  const __m256i zero = _mm256_setzero_si256();
+  while (end - p >= 32)
+  {
+    __m256i acc = _mm256_setzero_si256();
+    int i;
+    for (i=0; i < 255 && end - p >= 32; ++i, p += 32)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+      acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, newline));
+    }
+    __m256i sums = _mm256_sad_epu8(acc, zero);
+    count += _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+      _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+  }
+  return count + CountNewlinesSSE2(p, end);
+}
+#endif
+
+// The number of '\n' characters in [begin, end).
+inline index_type CountNewlines( const char *begin, const char *end )
+{
+#if defined(BIGMEMORY_RUNTIME_AVX2)
+  static const bool haveAVX2 = __builtin_cpu_supports("avx2");
+  if (haveAVX2)
+  {
+    return CountNewlinesAVX2(begin, end);
+  }
+#endif
+#if defined(__SSE2__)
+  return CountNewlinesSSE2(begin, end);
+#else
+  return CountNewlinesScalar(begin, end);
+#endif
+}
+
+// Advance past numLines lines.  Returns end if the text runs out first.
+inline const char* SkipLines( const char *begin, const char *end,
+  index_type numLines )
+{
+  const char *p = begin;
+  index_type i;
+  for (i=0; i < numLines && p < end; ++i)
+  {
+    p = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (p == NULL) return end;
+    ++p;
+  }
+  return p;
+}
+
+// Split [begin, end) into at most numChunks pieces of roughly equal size
+// whose interior boundaries fall just after a newline, so that every
+// line lies entirely in one chunk.  bounds receives the chunk
+// boundaries; chunk i is [bounds[i], bounds[i+1]).
+inline void SplitOnNewlines( const char *begin, const char *end,
+  index_type numChunks, std::vector<const char*> &bounds )
+{
+  bounds.clear();
+  bounds.push_back(begin);
+  if (numChunks < 1) numChunks = 1;
+  index_type chunkSize = static_cast<index_type>(end - begin) / numChunks;
+  index_type i;
+  for (i=1; i < numChunks && chunkSize > 0; ++i)
+  {
+    const char *p = begin + i*chunkSize;
+    if (p <= bounds.back()) continue;
+    p = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (p == NULL) break;
+    ++p;
+    if (p >= end) break;
+    bounds.push_back(p);
+  }
+  bounds.push_back(end);
+}
+
+// The number of lines, in the sense of getline, in a chunk.  A trailing
+// line without a newline only counts at the very end of the file.
+inline index_type CountLines( const char *begin, const char *end,
+  const bool lastChunk )
+{
+  index_type count = CountNewlines(begin, end);
+  if (lastChunk && end > begin && *(end-1) != '\n') ++count;
+  return count;
+}
+
+// Split the text into newline-aligned chunks and count the newlines in 
+// each chunk, using up to numThreads threads.  Returns the total number
+// of newlines.
+inline index_type ScanLines( const char *begin, const char *end,
+  index_type numChunks, int numThreads, std::vector<const char*> &bounds,
+  std::vector<index_type> &newlines )
+{
+  SplitOnNewlines(begin, end, numChunks, bounds);
+  index_type n = static_cast<index_type>(bounds.size()) - 1;
+  newlines.assign(n, 0);
+  index_type i;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(static)
+#endif
+  for (i=0; i < n; ++i)
+  {
+    newlines[i] = CountNewlines(bounds[i], bounds[i+1]);
+  }
+  index_type total = 0;
+  for (i=0; i < n; ++i)
+  {
+    total += newlines[i];
+  }
+  return total;
+}
+
+// The number of chunks worth using for a text of the given size.
+inline index_type NumTextChunks( const index_type size, const int numThreads )
+{
+  return (numThreads > 1 && size > (1 << 20)) ? 4 * numThreads : 1;
+}
+
+// Number formatting for WriteMatrix.  The output has to match what
+// ttos() (a stringstream with precision 16, i.e. "%.16g") has always
+// written, so these are fast routes to exactly that text rather than a
+// shortest round-trip format.  Each returns the number of characters
+// written to buf, which must hold at least 32.
+
+inline int FormatInteger( char *buf, long long val )
+{
+  char digits[24];
+  int n = 0;
+  unsigned long long u = val < 0 ? 
+    0ULL - static_cast<unsigned long long>(val) : 
+    static_cast<unsigned long long>(val);
+  do
+  {
+    digits[n++] = static_cast<char>('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+  int len = 0;
+  if (val < 0) buf[len++] = '-';
+  while (n > 0) buf[len++] = digits[--n];
+  return len;
+}
+
+#if defined(__SIZEOF_INT128__) && !defined(WINDOWS)
+// Write the 16 significant digits in sig, with decimal exponent exp10, 
+// the way %g does: fixed notation for -4 <= exp10 < 16, otherwise 
+// exponential, with trailing zeros removed.
+inline int FormatSignificand( char *buf, bool negative, 
+  unsigned long long sig, int exp10 )
+{
+  char digits[16];
+  int i;
+  for (i=15; i >= 0; --i)
+  {
+    digits[i] = static_cast<char>('0' + sig % 10);
+    sig /= 10;
+  }
+  int numDigits = 16;
+  while (numDigits > 1 && digits[numDigits-1] == '0') --numDigits;
+  int len = 0;
+  if (negative) buf[len++] = '-';
+  if (exp10 < -4 || exp10 >= 16)
+  {
+    buf[len++] = digits[0];
+    if (numDigits > 1)
+    {
+      buf[len++] = '.';
+      for (i=1; i < numDigits; ++i) buf[len++] = digits[i];
+    }
+    buf[len++] = 'e';
+    buf[len++] = exp10 < 0 ? '-' : '+';
+    int e = exp10 < 0 ? -exp10 : exp10;
+    if (e >= 100) buf[len++] = static_cast<char>('0' + e / 100);
+    buf[len++] = static_cast<char>('0' + (e / 10) % 10);
+    buf[len++] = static_cast<char>('0' + e % 10);
+  }
+  else if (exp10 >= 0)
+  {
+    for (i=0; i <= exp10; ++i) buf[len++] = digits[i];
+    if (numDigits > exp10+1)
+    {
+      buf[len++] = '.';
+      for (i=exp10+1; i < numDigits; ++i) buf[len++] = digits[i];
+    }
+  }
+  else
+  {
+    buf[len++] = '0';
+    buf[len++] = '.';
+    for (i=0; i < -exp10-1; ++i) buf[len++] = '0';
+    for (i=0; i < numDigits; ++i) buf[len++] = digits[i];
+  }
+  return len;
+}
+
+// Round a in [1e-7, 1e16) to 16 significant digits exactly.  a is 
+// m*2^-s with a 53-bit m, and m*10^q for q <= 22 fits in 128 bits, so 
+// the digits come from one multiply and shift, rounded half to even as 
+// printf does.
+inline int FormatDouble16Exact( char *buf, bool negative, double a )
+{
+  typedef unsigned __int128 uint128;
+  static const unsigned long long pow10[23] = {1ULL, 10ULL, 100ULL, 
+    1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 
+    10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 
+    10000000000000000000ULL, 0ULL, 0ULL, 0ULL};
+  int binExp;
+  double f = frexp(a, &binExp);
+  unsigned long long m = static_cast<unsigned long long>(ldexp(f, 53));
+  int s = 53 - binExp;
+  int exp10 = static_cast<int>(floor(log10(a)));
+  if (exp10 < -7) exp10 = -7;
+  if (exp10 > 15) exp10 = 15;
+  for (;;)
+  {
+    int q = 15 - exp10;
+    uint128 scale = q <= 19 ? static_cast<uint128>(pow10[q]) :
+      static_cast<uint128>(pow10[19]) * pow10[q-19];
+    uint128 p = static_cast<uint128>(m) * scale;
+    uint128 t = p >> s;
+    if (t >= static_cast<uint128>(pow10[16]) && exp10 < 15)
+    {
+      ++exp10;
+      continue;
+    }
+    if (t < static_cast<uint128>(pow10[15]) && exp10 > -7)
+    {
+      --exp10;
+      continue;
+    }
+    uint128 rem = p - (t << s);
+    uint128 half = static_cast<uint128>(1) << (s-1);
+    if (rem > half || (rem == half && (t & 1)))
+    {
+      ++t;
+    }
+    if (t == static_cast<uint128>(pow10[16]))
+    {
+      t = pow10[15];
+      ++exp10;
+    }
+    return FormatSignificand(buf, negative, 
+      static_cast<unsigned long long>(t), exp10);
+  }
+}
+#endif
+
+inline int FormatDouble16( char *buf, double val )
+{
+  if (std::isinf(val))
+  {
+    memcpy(buf, val < 0 ? "-inf" : "inf", val < 0 ? 4 : 3);
+    return val < 0 ? 4 : 3;
+  }
+  bool negative = std::signbit(val);
+  double a = negative ? -val : val;
+  if (a < 1e16 && a == floor(a))
+  {
+    int len = 0;
+    if (negative) buf[len++] = '-';
+    return len + FormatInteger(buf+len, static_cast<long long>(a));
+  }
+#if defined(__SIZEOF_INT128__) && !defined(WINDOWS)
+  if (a >= 1e-7 && a < 1e16)
+  {
+    return FormatDouble16Exact(buf, negative, a);
+  }
+#endif
+  return snprintf(buf, 32, "%.16g", val);
+}
+
+inline int FormatNumber( char *buf, char val ) 
+  {return FormatInteger(buf, val);}
+inline int FormatNumber( char *buf, short val ) 
+  {return FormatInteger(buf, val);}
+inline int FormatNumber( char *buf, int val ) 
+  {return FormatInteger(buf, val);}
+inline int FormatNumber( char *buf, float val ) 
+  {return FormatDouble16(buf, val);}
+inline int FormatNumber( char *buf, double val ) 
+  {return FormatDouble16(buf, val);}
+
+#endif // BIGMEMORY_TEXTFILE_HPP
@@ -0,0 +1,150 @@
+#ifndef BIGMEMORY_TRANSPOSE_HPP
+#define BIGMEMORY_TRANSPOSE_HPP
+
+// The engine behind t() for a big.matrix.  The input is cut into square
+// tiles small enough that the columns of a tile on both sides stay in
+// cache, and each tile is transposed a few elements at a time in
+// registers: 4x4 for 4-byte types and 2x2 for 8-byte types.  Tiles are
+// shared among threads a block at a time, so the caller can write back and
+// drop each block of a file-backed matrix before starting the next.
+
+#include <algorithm>
+
+#include "bigmemoryDefines.h"
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+const index_type TRANSPOSE_TILE = 64;
+// The rows and columns of the input handled between write-backs.
+const index_type TRANSPOSE_BLOCK = 4096;
+
+// Copy a width x width block: dst[r][col+c] = src[c][row+r].
+template<typename T, int Size=sizeof(T)>
+struct TransposeKernel
+{
+  static const index_type width = 1;
+  static void apply( const T* const *src, const index_type row,
+    T* const *dst, const index_type col )
+  {
+    dst[0][col] = src[0][row];
+  }
+};
+
+#if defined(__SSE2__)
+template<typename T>
+struct TransposeKernel<T, 4>
+{
+  static const index_type width = 4;
+  static void apply( const T* const *src, const index_type row,
+    T* const *dst, const index_type col )
+  {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[0]+row));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[1]+row));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[2]+row));
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[3]+row));
+    __m128i ab0 = _mm_unpacklo_epi32(a, b);
+    __m128i cd0 = _mm_unpacklo_epi32(c, d);
+    __m128i ab1 = _mm_unpackhi_epi32(a, b);
+    __m128i cd1 = _mm_unpackhi_epi32(c, d);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[0]+col),
+      _mm_unpacklo_epi64(ab0, cd0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[1]+col),
+      _mm_unpackhi_epi64(ab0, cd0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[2]+col),
+      _mm_unpacklo_epi64(ab1, cd1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[3]+col),
+      _mm_unpackhi_epi64(ab1, cd1));
+  }
+};
+
+template<typename T>
+struct TransposeKernel<T, 8>
+{
+  static const index_type width = 2;
+  static void apply( const T* const *src, const index_type row,
+    T* const *dst, const index_type col )
+  {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[0]+row));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[1]+row));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[0]+col),
+      _mm_unpacklo_epi64(a, b));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[1]+col),
+      _mm_unpackhi_epi64(a, b));
+  }
+};
+#endif
+
+// out[i][j] = in[j][i] for the rows [i0, i1) and columns [j0, j1) of in,
+// at most TRANSPOSE_TILE of each.
+template<typename InAccessorType, typename OutAccessorType>
+void TransposeTile( InAccessorType &in, OutAccessorType &out,
+  const index_type i0, const index_type i1, const index_type j0,
+  const index_type j1 )
+{
+  typedef typename InAccessorType::value_type T;
+  typedef TransposeKernel<T> Kernel;
+  const T *src[TRANSPOSE_TILE];
+  T *dst[TRANSPOSE_TILE];
+  const index_type ni = i1 - i0;
+  const index_type nj = j1 - j0;
+  index_type i, j;
+  for (j=0; j < nj; ++j)
+  {
+    src[j] = in[j0+j];
+  }
+  for (i=0; i < ni; ++i)
+  {
+    dst[i] = out[i0+i];
+  }
+  const index_type niBlocks = ni - ni % Kernel::width;
+  const index_type njBlocks = nj - nj % Kernel::width;
+  for (i=0; i < niBlocks; i += Kernel::width)
+  {
+    for (j=0; j < njBlocks; j += Kernel::width)
+    {
+      Kernel::apply(src+j, i0+i, dst+i, j0+j);
+    }
+    for (j=njBlocks; j < nj; ++j)
+    {
+      index_type k;
+      for (k=i; k < i+Kernel::width; ++k)
+      {
+        dst[k][j0+j] = src[j][i0+k];
+      }
+    }
+  }
+  for (i=niBlocks; i < ni; ++i)
+  {
+    for (j=0; j < nj; ++j)
+    {
+      dst[i][j0+j] = src[j][i0+i];
+    }
+  }
+}
+
+// Transpose the rows [i0, i1) and columns [j0, j1) of in into out, a tile
+// per task.
+template<typename InAccessorType, typename OutAccessorType>
+void TransposeBlock( InAccessorType &in, OutAccessorType &out,
+  const index_type i0, const index_type i1, const index_type j0,
+  const index_type j1, const int numThreads )
+{
+  const index_type tileRows = (i1 - i0 + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+  const index_type tileCols = (j1 - j0 + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+  index_type t;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(static)
+#endif
+  for (t=0; t < tileRows*tileCols; ++t)
+  {
+    // Neighbouring tasks share input columns.
+    const index_type ti = i0 + (t % tileRows) * TRANSPOSE_TILE;
+    const index_type tj = j0 + (t / tileRows) * TRANSPOSE_TILE;
+    TransposeTile(in, out, ti, std::min(ti + TRANSPOSE_TILE, i1), tj,
+      std::min(tj + TRANSPOSE_TILE, j1));
+  }
+}
+
+#endif // BIGMEMORY_TRANSPOSE_HPP
@@ -0,0 +1,76 @@
+#ifndef BIGMEMORY_ZONEMAP_H
+#define BIGMEMORY_ZONEMAP_H
+
+#include <string>
+#include <stdint.h>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "bigmemoryDefines.h"
+
+// The block size mwhich works in.
+const index_type ZONE_MAP_BLOCK_ROWS = 65536;
+
+// A summary of one block of rows of one column.  min and max cover every
+// value except NaN (the integer and float NA sentinels are ordinary
+// values here, as they are to mwhich), and naCount counts the NaNs.  A
+// block holding only NaNs has min > max.
+struct ZoneBlock
+{
+  double min;
+  double max;
+  int64_t naCount;
+};
+
+// Per-column block summaries for a file-backed matrix, kept in a file
+// next to the backing file so that every process attached to the matrix
+// shares them.  Each column has a generation that writers bump; a
+// column's summaries are only trusted when they were computed at the
+// current generation, and are otherwise recomputed when next needed.
+// Note: like SharedCounter, the generations are not mutex protected.
+class ZoneMap
+{
+  public:
+    ZoneMap() : _pRegion(NULL), _pColumns(NULL), _pBlocks(NULL),
+      _totalRows(0), _totalCols(0), _blockRows(0), _id(0) {}
+    ~ZoneMap() {reset();}
+
+    bool create( const std::string &fileName, const index_type totalRows,
+      const index_type totalCols, const int matrixType,
+      const index_type blockRows );
+    bool open( const std::string &fileName, const index_type totalRows,
+      const index_type totalCols, const int matrixType );
+    void reset();
+
+    // Differs between maps created at different times.
+    uint64_t id() const {return _id;}
+    index_type block_rows() const {return _blockRows;}
+    index_type num_blocks() const
+    {
+      return (_totalRows + _blockRows - 1) / _blockRows;
+    }
+    ZoneBlock* blocks( const index_type col )
+    {
+      return _pBlocks + col*num_blocks();
+    }
+    uint64_t generation( const index_type col ) const;
+    bool current( const index_type col ) const;
+    // Mark the summaries of col, computed when its generation was gen, as
+    // current.  Does nothing if the column was written to since.
+    void mark_current( const index_type col, const uint64_t gen );
+    // Record a write to col.
+    void touch( const index_type col );
+
+  private:
+    struct ZoneColumn
+    {
+      volatile uint64_t generation;
+      volatile uint64_t current;
+    };
+    boost::interprocess::mapped_region *_pRegion;
+    ZoneColumn *_pColumns;
+    ZoneBlock *_pBlocks;
+    index_type _totalRows, _totalCols, _blockRows;
+    uint64_t _id;
+};
+
+#endif // BIGMEMORY_ZONEMAP_H
@@ -2,6 +2,7 @@
 #define BIGMEMORY_UTIL_HPP
 
 #include "bigmemoryDefines.h"
+#include "ElementKernels.hpp"
 
 using namespace std;
 
@@ -16,6 +17,23 @@ std::string RChar2String(SEXP str);
 
 SEXP StringVec2RChar( const vector<string> &strVec );
 
+// The number of indices read from R at a time.
+const index_type INDEX_CHUNK = 4096;
+
+// Point at indices[first, first+n).  A compact sequence such as 1:n (or
+// any other ALTREP vector) is copied into buffer, which must hold n
+// values, rather than expanded in full.
+const double* IndexChunk( SEXP indices, const index_type first,
+  const index_type n, double *buffer );
+
+// Split the indices R passes into runs and return how many there are.
+// indices is a numeric vector of 1-based indices, or the "index.runs"
+// matrix of 1-based starts and lengths that CCleanIndices returns.
+index_type GetIndexRuns( SEXP indices, std::vector<IndexRun> &runs );
+
+// The same, as a vector of 1-based indices (NA for missing ones).
+index_type GetIndices( SEXP indices, std::vector<double> &values );
+
 // Removed because no longer required with Rcpp
 /*
 template<typename T>
@@ -18,7 +18,16 @@
 
 #include <boost/interprocess/sync/named_mutex.hpp>
 
+#ifndef WINDOWS
+#include <sys/mman.h>
+#endif
+// Linux 5.14 and later; older kernels reject it and we fall back.
+#if defined(LINUX) && !defined(MADV_POPULATE_READ)
+#define MADV_POPULATE_READ 22
+#endif
+
 #include "bigmemory/BigMatrix.h"
+#include "bigmemory/FileIO.hpp"
 
 #define COND_EXCEPTION_PRINT(bYes)                \
   if (bYes)                                       \
@@ -154,6 +163,23 @@ bool LocalBigMatrix::create(const index_type numRow, const index_type numCol,
   }
 }
 
+bool LocalBigMatrix::permute_columns( const Columns &order )
+{
+  if (!_sepCols || static_cast<index_type>(order.size()) != _ncol)
+  {
+    return false;
+  }
+  // The table holds T*, which are all alike.
+  char **p = reinterpret_cast<char**>(_pdata);
+  std::vector<char*> old(p, p + _ncol);
+  index_type i;
+  for (i=0; i < _ncol; ++i)
+  {
+    p[i] = old[order[i]];
+  }
+  return true;
+}
+
 bool LocalBigMatrix::destroy()
 {
   try
@@ -199,6 +225,158 @@ bool SharedBigMatrix::create_uuid()
     return true;
 }
 
+static index_type ElementSize( const int matrixType )
+{
+  return matrixType == 6 ?
+    static_cast<index_type>(sizeof(float)) :
+    static_cast<index_type>(matrixType);
+}
+
+// Fault in every page of a region now rather than on first access.
+static void PrefaultRegion( char *addr, const std::size_t size )
+{
+#ifdef MADV_POPULATE_READ
+  if (0 == madvise(addr, size, MADV_POPULATE_READ)) return;
+#endif
+#ifdef MADV_WILLNEED
+  madvise(addr, size, MADV_WILLNEED);
+#endif
+  const std::size_t pageSize = mapped_region::get_page_size();
+  volatile char sink = 0;
+  std::size_t offset;
+  for (offset=0; offset < size; offset += pageSize)
+  {
+    sink += addr[offset];
+  }
+}
+
+// Huge pages are only a request: MADV_HUGEPAGE takes effect when
+// transparent huge pages are enabled for the kind of memory mapped.
+bool SharedBigMatrix::map_policy( const int newPolicy )
+{
+  bool ok = true;
+  std::size_t i;
+  for (i=0; i < _dataRegionPtrs.size(); ++i)
+  {
+    char *addr = reinterpret_cast<char*>(_dataRegionPtrs[i]->get_address());
+    std::size_t size = _dataRegionPtrs[i]->get_size();
+    if ((newPolicy ^ _mapPolicy) & POLICY_HUGEPAGES)
+    {
+#ifdef MADV_HUGEPAGE
+      ok = (0 == madvise(addr, size, (newPolicy & POLICY_HUGEPAGES) ? 
+        MADV_HUGEPAGE : MADV_NOHUGEPAGE)) && ok;
+#else
+      ok = false;
+#endif
+    }
+    if (newPolicy & POLICY_PREFAULT)
+    {
+      PrefaultRegion(addr, size);
+    }
+  }
+  if (ok)
+  {
+    _mapPolicy = newPolicy;
+  }
+  return ok;
+}
+
+// Widen the byte span [begin, end) of region to whole pages, clamping the
+// end to the size of the region.
+static void AlignSpanToPages( MappedRegion &region, index_type &begin,
+  index_type &end )
+{
+  const index_type pageSize = 
+    static_cast<index_type>(mapped_region::get_page_size());
+  index_type size = static_cast<index_type>(region.get_size());
+  begin -= begin % pageSize;
+  end = std::min(size, (end + pageSize - 1) / pageSize * pageSize);
+}
+
+// Advise the kernel about the bytes [begin, end) of region, widened to
+// whole pages.
+static bool AdviseSpan( MappedRegion &region, index_type begin,
+  index_type end, const int advice )
+{
+#ifdef WINDOWS
+  return false;
+#else
+  char *base = reinterpret_cast<char*>(region.get_address());
+  AlignSpanToPages(region, begin, end);
+  if (end <= begin) return true;
+  return 0 == madvise(base + begin, static_cast<std::size_t>(end - begin),
+    advice);
+#endif
+}
+
+bool SharedBigMatrix::for_each_span( SpanOperation op, const int arg,
+  const index_type firstRow, const index_type lastRow,
+  const index_type firstCol, const index_type lastCol )
+{
+  if (firstRow < 0 || lastRow > _nrow || firstCol < 0 || lastCol > _ncol ||
+    firstRow > lastRow || firstCol > lastCol)
+  {
+    return false;
+  }
+  if (firstRow == lastRow || firstCol == lastCol)
+  {
+    return true;
+  }
+  const index_type es = ElementSize(_matType);
+  const index_type rowBegin = (_rowOffset + firstRow) * es;
+  const index_type rowEnd = (_rowOffset + lastRow) * es;
+  bool ok = true;
+  index_type j;
+  if (_sepCols)
+  {
+    for (j=_colOffset+firstCol; j < _colOffset+lastCol; ++j)
+    {
+      ok = op(*_dataRegionPtrs[j], rowBegin, rowEnd, arg) && ok;
+    }
+  }
+  else if (rowEnd - rowBegin == _totalRows*es)
+  {
+    // Whole columns are one contiguous span.
+    ok = op(*_dataRegionPtrs[0], (_colOffset+firstCol)*_totalRows*es,
+      (_colOffset+lastCol)*_totalRows*es, arg);
+  }
+  else
+  {
+    for (j=_colOffset+firstCol; j < _colOffset+lastCol; ++j)
+    {
+      ok = op(*_dataRegionPtrs[0], j*_totalRows*es + rowBegin,
+        j*_totalRows*es + rowEnd, arg) && ok;
+    }
+  }
+  return ok;
+}
+
+bool SharedBigMatrix::advise( const int pattern, const index_type firstRow,
+  const index_type lastRow, const index_type firstCol,
+  const index_type lastCol )
+{
+#ifdef WINDOWS
+  return false;
+#else
+  int advice;
+  switch (pattern)
+  {
+    case ADVICE_NORMAL: advice = MADV_NORMAL; break;
+    case ADVICE_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+    case ADVICE_RANDOM: advice = MADV_RANDOM; break;
+    case ADVICE_WILLNEED: advice = MADV_WILLNEED; break;
+    case ADVICE_DONTNEED: advice = MADV_DONTNEED; break;
+    default: return false;
+  }
+  if (firstRow >= lastRow || firstCol >= lastCol)
+  {
+    return false;
+  }
+  return for_each_span(AdviseSpan, advice, firstRow, lastRow, firstCol,
+    lastCol);
+#endif
+}
+
 template<typename T>
 void CreateSharedSepMatrix( const std::string &sharedName, 
   MappedRegionPtrs &dataRegionPtrs, const index_type nrow, 
@@ -803,10 +981,13 @@ void* CreateFileBackedSepMatrix( const std::string &fileName,
     ncol);
 }
 
+// With an embedded header, only the data section (numElems elements
+// starting at dataOffset) is mapped; otherwise the whole file is.
 template<typename T>
 void* ConnectFileBackedMatrix( const std::string &fileName, 
   const std::string &filePath, MappedRegionPtrs &dataRegionPtrs, 
-  const bool readOnly=false )
+  const bool readOnly=false, const index_type dataOffset=0,
+  const index_type numElems=0 )
 {
   //COND_PRINT(DEBUG, "Connecting to file %s\n", (filePath + fileName).c_str())
   try
@@ -815,7 +996,8 @@ void* ConnectFileBackedMatrix( const std::string &fileName,
       (readOnly ? read_only : read_write));
     dataRegionPtrs.push_back(
       MappedRegionPtr(new MappedRegion(mFile, 
-        (readOnly ? read_only : read_write))));
+        (readOnly ? read_only : read_write), dataOffset,
+        static_cast<std::size_t>(dataOffset ? numElems*sizeof(T) : 0))));
   }
   catch (std::bad_alloc &e)
   {
@@ -829,7 +1011,7 @@ void* ConnectFileBackedMatrix( const std::string &fileName,
 template<typename T>
 void* CreateFileBackedMatrix(const std::string &fileName, 
   const std::string &filePath, MappedRegionPtrs &dataRegionPtrs, 
-  const index_type nrow, const index_type ncol)
+  const index_type nrow, const index_type ncol, const index_type dataOffset=0)
 {
   // Create the file.
   std::string fullFileName = filePath+fileName;
@@ -841,7 +1023,7 @@ void* CreateFileBackedMatrix(const std::string &fileName,
     COND_PRINT(DEBUG, "Problem creating file %s.\n", fullFileName.c_str());
     return NULL;
   }  
-  if (-1 == ftruncate( fileno(fp), nrow*ncol*sizeof(T) ) )
+  if (-1 == ftruncate( fileno(fp), dataOffset + nrow*ncol*sizeof(T) ) )
   {
     COND_PRINT(DEBUG, "Error: %s\n", strerror(errno));
     fclose(fp);
@@ -856,18 +1038,18 @@ void* CreateFileBackedMatrix(const std::string &fileName,
   {
     return NULL;
   }
-  fbuf.pubseekoff(nrow*ncol*sizeof(T), std::ios_base::beg);
+  fbuf.pubseekoff(dataOffset + nrow*ncol*sizeof(T), std::ios_base::beg);
   // I'm not sure if I need this next line
   fbuf.sputc(0);
   fbuf.close();
 #endif
   return ConnectFileBackedMatrix<T>(fileName, filePath,
-    dataRegionPtrs);
+    dataRegionPtrs, false, dataOffset, nrow*ncol);
 }
 
 bool FileBackedBigMatrix::create(const std::string &fileName, 
   const std::string &filePath, const index_type numRow, const index_type numCol,
-  const int matrixType, const bool sepCols)
+  const int matrixType, const bool sepCols, const bool embedHeader)
 {
   if (!create_uuid())
   {
@@ -884,6 +1066,10 @@ bool FileBackedBigMatrix::create(const std::string &fileName,
     _totalCols = _ncol;
     _matType = matrixType;
     _sepCols = sepCols;
+    _embedded = embedHeader;
+    _dataOffset = (_embedded && !_sepCols) ? BACKING_HEADER_SIZE : 0;
+    // Summaries left over from an earlier matrix of the same name.
+    remove(zone_map_file().c_str());
     if (_sepCols)
     {
       switch(_matType)
@@ -915,30 +1101,30 @@ bool FileBackedBigMatrix::create(const std::string &fileName,
       {
         case 1:
           _pdata = CreateFileBackedMatrix<char>(_fileName, filePath,
-            _dataRegionPtrs, _nrow, _ncol);
+            _dataRegionPtrs, _nrow, _ncol, _dataOffset);
           break;
         case 2:
           _pdata = CreateFileBackedMatrix<short>(_fileName, filePath,
-            _dataRegionPtrs, _nrow, _ncol);
+            _dataRegionPtrs, _nrow, _ncol, _dataOffset);
           break;
         case 4:
           _pdata = CreateFileBackedMatrix<int>(_fileName, filePath,
-            _dataRegionPtrs, _nrow, _ncol);
+            _dataRegionPtrs, _nrow, _ncol, _dataOffset);
           break;
         case 6:
           _pdata = CreateFileBackedMatrix<float>(_fileName, filePath,
-            _dataRegionPtrs, _nrow, _ncol);
+            _dataRegionPtrs, _nrow, _ncol, _dataOffset);
           break;
         case 8:
           _pdata = CreateFileBackedMatrix<double>(_fileName, filePath,
-            _dataRegionPtrs, _nrow, _ncol);
+            _dataRegionPtrs, _nrow, _ncol, _dataOffset);
       }
     }
     if (!_pdata)
     {
       return false;
     }
-    return true;
+    return !_embedded || write_header();
   }
   catch(std::exception &e)
   {
@@ -947,22 +1133,133 @@ bool FileBackedBigMatrix::create(const std::string &fileName,
   }
 }
 
+// Read and check the header at the start of fileName; false if the file
+// has none.
+static bool ReadBackingFileHeader( const std::string &fileName,
+  BackingFileHeader &header, Names *colNames=NULL, Names *rowNames=NULL )
+{
+  int fd = OpenFile(fileName, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  bool ok = ReadFully(fd, reinterpret_cast<char*>(&header), sizeof(header), 0)
+    && 0 == memcmp(header.magic, BACKING_HEADER_MAGIC, sizeof(header.magic))
+    && header.byteOrder == BACKING_HEADER_BYTE_ORDER
+    && header.version <= BACKING_HEADER_VERSION;
+  if (ok && colNames && rowNames && header.namesLength > 0)
+  {
+    std::string block(static_cast<std::size_t>(header.namesLength), '\0');
+    std::size_t pos = 0;
+    ok = ReadFully(fd, &block[0], header.namesLength, header.namesOffset) &&
+      ReadNamesBlock(block, pos, *colNames) &&
+      ReadNamesBlock(block, pos, *rowNames);
+  }
+  CloseFile(fd);
+  return ok;
+}
+
+bool FileBackedBigMatrix::write_header()
+{
+  BackingFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BACKING_HEADER_MAGIC, sizeof(header.magic));
+  header.byteOrder = BACKING_HEADER_BYTE_ORDER;
+  header.version = BACKING_HEADER_VERSION;
+  header.matrixType = _matType;
+  header.sepCols = _sepCols;
+  header.totalRows = _totalRows;
+  header.totalCols = _totalCols;
+  header.dataOffset = _dataOffset;
+
+  std::string names;
+  AppendNamesBlock(names, _colNames);
+  AppendNamesBlock(names, _rowNames);
+  header.namesLength = names.size();
+  // The names go in the space before the data when they fit there, and
+  // after it otherwise.
+  index_type dataEnd = _sepCols ? static_cast<index_type>(sizeof(header)) :
+    _dataOffset + _totalRows*_totalCols*ElementSize(_matType);
+  header.namesOffset = (_sepCols ||
+    static_cast<index_type>(sizeof(header) + names.size()) <= _dataOffset) ?
+    static_cast<index_type>(sizeof(header)) : dataEnd;
+
+  int fd = OpenFile(_filePath + _fileName, O_RDWR | O_CREAT);
+  if (fd < 0)
+  {
+    return false;
+  }
+  index_type fileSize = std::max(dataEnd,
+    static_cast<index_type>(header.namesOffset + header.namesLength));
+  bool ok = ResizeFile(fd, fileSize) &&
+    WriteFully(fd, names.data(), names.size(), header.namesOffset) &&
+    WriteFully(fd, reinterpret_cast<const char*>(&header), sizeof(header), 0);
+  CloseFile(fd);
+  _embedded = ok;
+  return ok;
+}
+
 bool FileBackedBigMatrix::connect( const std::string &fileName, 
   const std::string &filePath, const index_type numRow, 
   const index_type numCol, const int matrixType, 
   const bool sepCols, const bool readOnly)
+{
+  _fileName = fileName;
+  _filePath = filePath;
+  _nrow = numRow;
+  _totalRows = _nrow;
+  _ncol = numCol;
+  _totalCols = _ncol;
+  _matType = matrixType;
+  _sepCols = sepCols;
+  _readOnly = readOnly;
+  // A backing file with an embedded header keeps its data further in.
+  BackingFileHeader header;
+  _embedded = ReadBackingFileHeader(_filePath + _fileName, header);
+  if (_embedded && (header.totalRows != _totalRows ||
+    header.totalCols != _totalCols || header.matrixType != _matType ||
+    (header.sepCols != 0) != _sepCols))
+  {
+    return false;
+  }
+  _dataOffset = _embedded ? header.dataOffset : 0;
+  return map_files();
+}
+
+bool FileBackedBigMatrix::attach( const std::string &fileName,
+  const std::string &filePath, const bool readOnly )
+{
+  BackingFileHeader header;
+  Names colNames, rowNames;
+  if (!ReadBackingFileHeader(filePath + fileName, header, &colNames,
+    &rowNames))
+  {
+    return false;
+  }
+  _fileName = fileName;
+  _filePath = filePath;
+  _nrow = header.totalRows;
+  _totalRows = _nrow;
+  _ncol = header.totalCols;
+  _totalCols = _ncol;
+  _matType = header.matrixType;
+  _sepCols = header.sepCols != 0;
+  _readOnly = readOnly;
+  _embedded = true;
+  _dataOffset = header.dataOffset;
+  if (!map_files())
+  {
+    return false;
+  }
+  _colNames.swap(colNames);
+  _rowNames.swap(rowNames);
+  return true;
+}
+
+bool FileBackedBigMatrix::map_files()
 {
   try
   {
-    _fileName = fileName;
-    _filePath = filePath;
-    _nrow = numRow;
-    _totalRows = _nrow;
-    _ncol = numCol;
-    _totalCols = _ncol;
-    _matType = matrixType;
-    _sepCols = sepCols;
-    _readOnly = readOnly;
     if (_sepCols)
     {
       switch(_matType)
@@ -970,7 +1267,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
         case 1:
           try
           {
-            _pdata = ConnectFileBackedSepMatrix<char>(_fileName, filePath,
+            _pdata = ConnectFileBackedSepMatrix<char>(_fileName, _filePath,
               _dataRegionPtrs, _ncol, _readOnly);
           }
           catch(boost::interprocess::interprocess_exception &e)
@@ -978,7 +1275,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedSepMatrix<char>(_fileName, filePath,
+              _pdata = ConnectFileBackedSepMatrix<char>(_fileName, _filePath,
                 _dataRegionPtrs, _ncol, _readOnly);
             }
           }
@@ -986,7 +1283,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
         case 2:
           try
           {
-            _pdata = ConnectFileBackedSepMatrix<short>(_fileName, filePath,
+            _pdata = ConnectFileBackedSepMatrix<short>(_fileName, _filePath,
             _dataRegionPtrs, _ncol, _readOnly);
           }
           catch(boost::interprocess::interprocess_exception &e)
@@ -994,7 +1291,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedSepMatrix<short>(_fileName, filePath,
+              _pdata = ConnectFileBackedSepMatrix<short>(_fileName, _filePath,
                 _dataRegionPtrs, _ncol, _readOnly);
             }
           }
@@ -1002,7 +1299,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
         case 4:
           try
           {
-            _pdata = ConnectFileBackedSepMatrix<int>(_fileName, filePath,
+            _pdata = ConnectFileBackedSepMatrix<int>(_fileName, _filePath,
               _dataRegionPtrs, _ncol, _readOnly);
           }
           catch(boost::interprocess::interprocess_exception &e)
@@ -1010,7 +1307,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedSepMatrix<int>(_fileName, filePath,
+              _pdata = ConnectFileBackedSepMatrix<int>(_fileName, _filePath,
                 _dataRegionPtrs, _ncol, _readOnly);
             }
           }
@@ -1018,7 +1315,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
         case 6:
           try
           {
-            _pdata = ConnectFileBackedSepMatrix<float>(_fileName, filePath,
+            _pdata = ConnectFileBackedSepMatrix<float>(_fileName, _filePath,
               _dataRegionPtrs, _ncol, _readOnly);
           }
           catch(boost::interprocess::interprocess_exception &e)
@@ -1026,7 +1323,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedSepMatrix<float>(_fileName, filePath,
+              _pdata = ConnectFileBackedSepMatrix<float>(_fileName, _filePath,
                 _dataRegionPtrs, _ncol, _readOnly);
             }
           }
@@ -1034,7 +1331,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
         case 8:
           try
           {
-            _pdata = ConnectFileBackedSepMatrix<double>(_fileName, filePath,
+            _pdata = ConnectFileBackedSepMatrix<double>(_fileName, _filePath,
               _dataRegionPtrs, _ncol, _readOnly);
           }
           catch(boost::interprocess::interprocess_exception &e)
@@ -1042,7 +1339,7 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedSepMatrix<double>(_fileName, filePath,
+              _pdata = ConnectFileBackedSepMatrix<double>(_fileName, _filePath,
                 _dataRegionPtrs, _ncol, _readOnly);
             }
           }
@@ -1055,80 +1352,80 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
         case 1:
           try
           {
-            _pdata = ConnectFileBackedMatrix<char>(_fileName, filePath, 
-              _dataRegionPtrs, _readOnly);
+            _pdata = ConnectFileBackedMatrix<char>(_fileName, _filePath, 
+              _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
           }
           catch(boost::interprocess::interprocess_exception &e)
           {
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedMatrix<char>(_fileName, filePath,
-                _dataRegionPtrs, _readOnly);
+              _pdata = ConnectFileBackedMatrix<char>(_fileName, _filePath,
+                _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
             }
           }
           break;
         case 2:
           try
           {
-            _pdata = ConnectFileBackedMatrix<short>(_fileName, filePath, 
-              _dataRegionPtrs, _readOnly);
+            _pdata = ConnectFileBackedMatrix<short>(_fileName, _filePath, 
+              _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
           }
           catch(boost::interprocess::interprocess_exception &e)
           {
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedMatrix<short>(_fileName, filePath,
-                _dataRegionPtrs, _readOnly);
+              _pdata = ConnectFileBackedMatrix<short>(_fileName, _filePath,
+                _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
             }
           }
           break;
         case 4:
           try
           {
-            _pdata = ConnectFileBackedMatrix<int>(_fileName, filePath, 
-              _dataRegionPtrs, _readOnly);
+            _pdata = ConnectFileBackedMatrix<int>(_fileName, _filePath, 
+              _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
           }
           catch(boost::interprocess::interprocess_exception &e)
           {
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedMatrix<int>(_fileName, filePath,
-                _dataRegionPtrs, _readOnly);
+              _pdata = ConnectFileBackedMatrix<int>(_fileName, _filePath,
+                _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
             }
           }
           break;
         case 6:
           try
           {
-            _pdata = ConnectFileBackedMatrix<float>(_fileName, filePath, 
-              _dataRegionPtrs, _readOnly);
+            _pdata = ConnectFileBackedMatrix<float>(_fileName, _filePath, 
+              _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
           }
           catch(boost::interprocess::interprocess_exception &e)
           {
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedMatrix<float>(_fileName, filePath,
-                _dataRegionPtrs, _readOnly);
+              _pdata = ConnectFileBackedMatrix<float>(_fileName, _filePath,
+                _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
             }
           }
           break;
         case 8:
           try
           {
-            _pdata = ConnectFileBackedMatrix<double>(_fileName, filePath, 
-              _dataRegionPtrs, _readOnly);
+            _pdata = ConnectFileBackedMatrix<double>(_fileName, _filePath, 
+              _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
           }
           catch(boost::interprocess::interprocess_exception &e)
           {
             if (!_readOnly)
             {
               _readOnly=true;
-              _pdata = ConnectFileBackedMatrix<double>(_fileName, filePath,
-                _dataRegionPtrs, _readOnly);
+              _pdata = ConnectFileBackedMatrix<double>(_fileName, _filePath,
+                _dataRegionPtrs, _readOnly, _dataOffset, _nrow*_ncol);
             }
           }
       }
@@ -1137,6 +1434,15 @@ bool FileBackedBigMatrix::connect( const std::string &fileName,
     {
       return false;
     }
+    ZoneMap *pZoneMap = new ZoneMap();
+    if (pZoneMap->open(zone_map_file(), _totalRows, _totalCols, _matType))
+    {
+      _zoneMap.reset(pZoneMap);
+    }
+    else
+    {
+      delete pZoneMap;
+    }
     return true;
   }
   catch(std::exception &e)
@@ -1163,10 +1469,34 @@ void DestroyFileBackedSepMatrix( const std::string &sharedName,
   }
 }
 
+bool FileBackedBigMatrix::zone_map( const bool enable )
+{
+  _zoneMap.reset();
+  if (!enable)
+  {
+    remove(zone_map_file().c_str());
+    return true;
+  }
+  if (_readOnly)
+  {
+    return false;
+  }
+  ZoneMap *pZoneMap = new ZoneMap();
+  if (!pZoneMap->create(zone_map_file(), _totalRows, _totalCols, _matType,
+    ZONE_MAP_BLOCK_ROWS))
+  {
+    delete pZoneMap;
+    return false;
+  }
+  _zoneMap.reset(pZoneMap);
+  return true;
+}
+
 bool FileBackedBigMatrix::destroy()
 {
   try
   {
+    _zoneMap.reset();
     _dataRegionPtrs.resize(0);
     if (_sepCols) 
     {
@@ -1216,15 +1546,14 @@ bool FileBackedBigMatrix::destroy()
   }
 }
 
-bool FileBackedBigMatrix::flush()
+bool FileBackedBigMatrix::flush( const bool async )
 {
   std::size_t i;
   try
   {
     for (i=0; i < _dataRegionPtrs.size(); ++i)
     {
-      // Perform a synchronous flush.
-      if ( !(_dataRegionPtrs[i])->flush(0, 0, false) ) return false;
+      if ( !(_dataRegionPtrs[i])->flush(0, 0, async) ) return false;
     }
   }
   catch(std::exception &e)
@@ -1234,3 +1563,28 @@ bool FileBackedBigMatrix::flush()
   }
   return true;
 }
+
+static bool FlushSpan( MappedRegion &region, index_type begin,
+  index_type end, int async )
+{
+  AlignSpanToPages(region, begin, end);
+  if (end <= begin) return true;
+  return region.flush(static_cast<std::size_t>(begin),
+    static_cast<std::size_t>(end - begin), async != 0);
+}
+
+bool FileBackedBigMatrix::flush( const index_type firstRow, 
+  const index_type lastRow, const index_type firstCol, 
+  const index_type lastCol, const bool async )
+{
+  try
+  {
+    return for_each_span(FlushSpan, async, firstRow, lastRow, firstCol,
+      lastCol);
+  }
+  catch(std::exception &e)
+  {
+    COND_EXCEPTION_PRINT(DEBUG);
+    return false;
+  }
+}
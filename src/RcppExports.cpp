@@ -5,6 +5,19 @@
 
 using namespace Rcpp;
 
+// GetMatrixColumnView
+SEXP GetMatrixColumnView(SEXP bigMatAddr, SEXP col, SEXP whole);
+RcppExport SEXP bigmemory_GetMatrixColumnView(SEXP bigMatAddrSEXP, SEXP colSEXP, SEXP wholeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type bigMatAddr(bigMatAddrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type col(colSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type whole(wholeSEXP);
+    __result = Rcpp::wrap(GetMatrixColumnView(bigMatAddr, col, whole));
+    return __result;
+END_RCPP
+}
 // GetIndivMatrixElements
 SEXP GetIndivMatrixElements(SEXP bigMatAddr, SEXP col, SEXP row);
 RcppExport SEXP bigmemory_GetIndivMatrixElements(SEXP bigMatAddrSEXP, SEXP colSEXP, SEXP rowSEXP) {
@@ -92,9 +105,21 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// CTranspose
+void CTranspose(SEXP inAddr, SEXP outAddr, SEXP threads);
+RcppExport SEXP bigmemory_CTranspose(SEXP inAddrSEXP, SEXP outAddrSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type inAddr(inAddrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type outAddr(outAddrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    CTranspose(inAddr, outAddr, threads);
+    return R_NilValue;
+END_RCPP
+}
 // OrderRIntMatrix
-SEXP OrderRIntMatrix(SEXP matrixVector, SEXP nrow, SEXP columns, SEXP naLast, SEXP decreasing);
-RcppExport SEXP bigmemory_OrderRIntMatrix(SEXP matrixVectorSEXP, SEXP nrowSEXP, SEXP columnsSEXP, SEXP naLastSEXP, SEXP decreasingSEXP) {
+SEXP OrderRIntMatrix(SEXP matrixVector, SEXP nrow, SEXP columns, SEXP naLast, SEXP decreasing, SEXP threads);
+RcppExport SEXP bigmemory_OrderRIntMatrix(SEXP matrixVectorSEXP, SEXP nrowSEXP, SEXP columnsSEXP, SEXP naLastSEXP, SEXP decreasingSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
@@ -103,13 +128,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type columns(columnsSEXP);
     Rcpp::traits::input_parameter< SEXP >::type naLast(naLastSEXP);
     Rcpp::traits::input_parameter< SEXP >::type decreasing(decreasingSEXP);
-    __result = Rcpp::wrap(OrderRIntMatrix(matrixVector, nrow, columns, naLast, decreasing));
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(OrderRIntMatrix(matrixVector, nrow, columns, naLast, decreasing, threads));
     return __result;
 END_RCPP
 }
 // OrderRNumericMatrix
-SEXP OrderRNumericMatrix(SEXP matrixVector, SEXP nrow, SEXP columns, SEXP naLast, SEXP decreasing);
-RcppExport SEXP bigmemory_OrderRNumericMatrix(SEXP matrixVectorSEXP, SEXP nrowSEXP, SEXP columnsSEXP, SEXP naLastSEXP, SEXP decreasingSEXP) {
+SEXP OrderRNumericMatrix(SEXP matrixVector, SEXP nrow, SEXP columns, SEXP naLast, SEXP decreasing, SEXP threads);
+RcppExport SEXP bigmemory_OrderRNumericMatrix(SEXP matrixVectorSEXP, SEXP nrowSEXP, SEXP columnsSEXP, SEXP naLastSEXP, SEXP decreasingSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
@@ -118,13 +144,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type columns(columnsSEXP);
     Rcpp::traits::input_parameter< SEXP >::type naLast(naLastSEXP);
     Rcpp::traits::input_parameter< SEXP >::type decreasing(decreasingSEXP);
-    __result = Rcpp::wrap(OrderRNumericMatrix(matrixVector, nrow, columns, naLast, decreasing));
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(OrderRNumericMatrix(matrixVector, nrow, columns, naLast, decreasing, threads));
     return __result;
 END_RCPP
 }
 // OrderBigMatrix
-SEXP OrderBigMatrix(SEXP address, SEXP columns, SEXP naLast, SEXP decreasing);
-RcppExport SEXP bigmemory_OrderBigMatrix(SEXP addressSEXP, SEXP columnsSEXP, SEXP naLastSEXP, SEXP decreasingSEXP) {
+SEXP OrderBigMatrix(SEXP address, SEXP columns, SEXP naLast, SEXP decreasing, SEXP threads);
+RcppExport SEXP bigmemory_OrderBigMatrix(SEXP addressSEXP, SEXP columnsSEXP, SEXP naLastSEXP, SEXP decreasingSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
@@ -132,7 +159,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type columns(columnsSEXP);
     Rcpp::traits::input_parameter< SEXP >::type naLast(naLastSEXP);
     Rcpp::traits::input_parameter< SEXP >::type decreasing(decreasingSEXP);
-    __result = Rcpp::wrap(OrderBigMatrix(address, columns, naLast, decreasing));
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(OrderBigMatrix(address, columns, naLast, decreasing, threads));
     return __result;
 END_RCPP
 }
@@ -452,8 +480,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // MWhichBigMatrix
-SEXP MWhichBigMatrix(SEXP bigMatAddr, SEXP selectColumn, SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal);
-RcppExport SEXP bigmemory_MWhichBigMatrix(SEXP bigMatAddrSEXP, SEXP selectColumnSEXP, SEXP minValSEXP, SEXP maxValSEXP, SEXP chkMinSEXP, SEXP chkMaxSEXP, SEXP opValSEXP) {
+SEXP MWhichBigMatrix(SEXP bigMatAddr, SEXP selectColumn, SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal, SEXP threads);
+RcppExport SEXP bigmemory_MWhichBigMatrix(SEXP bigMatAddrSEXP, SEXP selectColumnSEXP, SEXP minValSEXP, SEXP maxValSEXP, SEXP chkMinSEXP, SEXP chkMaxSEXP, SEXP opValSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
@@ -464,13 +492,29 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type chkMin(chkMinSEXP);
     Rcpp::traits::input_parameter< SEXP >::type chkMax(chkMaxSEXP);
     Rcpp::traits::input_parameter< SEXP >::type opVal(opValSEXP);
-    __result = Rcpp::wrap(MWhichBigMatrix(bigMatAddr, selectColumn, minVal, maxVal, chkMin, chkMax, opVal));
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(MWhichBigMatrix(bigMatAddr, selectColumn, minVal, maxVal, chkMin, chkMax, opVal, threads));
+    return __result;
+END_RCPP
+}
+// CIndexRange
+SEXP CIndexRange(SEXP indexAddr, SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax);
+RcppExport SEXP bigmemory_CIndexRange(SEXP indexAddrSEXP, SEXP minValSEXP, SEXP maxValSEXP, SEXP chkMinSEXP, SEXP chkMaxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type indexAddr(indexAddrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type minVal(minValSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type maxVal(maxValSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type chkMin(chkMinSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type chkMax(chkMaxSEXP);
+    __result = Rcpp::wrap(CIndexRange(indexAddr, minVal, maxVal, chkMin, chkMax));
     return __result;
 END_RCPP
 }
 // MWhichRIntMatrix
-SEXP MWhichRIntMatrix(SEXP matrixVector, SEXP nrow, SEXP selectColumn, SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal);
-RcppExport SEXP bigmemory_MWhichRIntMatrix(SEXP matrixVectorSEXP, SEXP nrowSEXP, SEXP selectColumnSEXP, SEXP minValSEXP, SEXP maxValSEXP, SEXP chkMinSEXP, SEXP chkMaxSEXP, SEXP opValSEXP) {
+SEXP MWhichRIntMatrix(SEXP matrixVector, SEXP nrow, SEXP selectColumn, SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal, SEXP threads);
+RcppExport SEXP bigmemory_MWhichRIntMatrix(SEXP matrixVectorSEXP, SEXP nrowSEXP, SEXP selectColumnSEXP, SEXP minValSEXP, SEXP maxValSEXP, SEXP chkMinSEXP, SEXP chkMaxSEXP, SEXP opValSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
@@ -482,13 +526,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type chkMin(chkMinSEXP);
     Rcpp::traits::input_parameter< SEXP >::type chkMax(chkMaxSEXP);
     Rcpp::traits::input_parameter< SEXP >::type opVal(opValSEXP);
-    __result = Rcpp::wrap(MWhichRIntMatrix(matrixVector, nrow, selectColumn, minVal, maxVal, chkMin, chkMax, opVal));
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(MWhichRIntMatrix(matrixVector, nrow, selectColumn, minVal, maxVal, chkMin, chkMax, opVal, threads));
     return __result;
 END_RCPP
 }
 // MWhichRNumericMatrix
-SEXP MWhichRNumericMatrix(SEXP matrixVector, SEXP nrow, SEXP selectColumn, SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal);
-RcppExport SEXP bigmemory_MWhichRNumericMatrix(SEXP matrixVectorSEXP, SEXP nrowSEXP, SEXP selectColumnSEXP, SEXP minValSEXP, SEXP maxValSEXP, SEXP chkMinSEXP, SEXP chkMaxSEXP, SEXP opValSEXP) {
+SEXP MWhichRNumericMatrix(SEXP matrixVector, SEXP nrow, SEXP selectColumn, SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal, SEXP threads);
+RcppExport SEXP bigmemory_MWhichRNumericMatrix(SEXP matrixVectorSEXP, SEXP nrowSEXP, SEXP selectColumnSEXP, SEXP minValSEXP, SEXP maxValSEXP, SEXP chkMinSEXP, SEXP chkMaxSEXP, SEXP opValSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
@@ -500,24 +545,26 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type chkMin(chkMinSEXP);
     Rcpp::traits::input_parameter< SEXP >::type chkMax(chkMaxSEXP);
     Rcpp::traits::input_parameter< SEXP >::type opVal(opValSEXP);
-    __result = Rcpp::wrap(MWhichRNumericMatrix(matrixVector, nrow, selectColumn, minVal, maxVal, chkMin, chkMax, opVal));
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(MWhichRNumericMatrix(matrixVector, nrow, selectColumn, minVal, maxVal, chkMin, chkMax, opVal, threads));
     return __result;
 END_RCPP
 }
 // CCountLines
-SEXP CCountLines(SEXP fileName);
-RcppExport SEXP bigmemory_CCountLines(SEXP fileNameSEXP) {
+SEXP CCountLines(SEXP fileName, SEXP threads);
+RcppExport SEXP bigmemory_CCountLines(SEXP fileNameSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
     Rcpp::traits::input_parameter< SEXP >::type fileName(fileNameSEXP);
-    __result = Rcpp::wrap(CCountLines(fileName));
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(CCountLines(fileName, threads));
     return __result;
 END_RCPP
 }
 // ReadMatrix
-SEXP ReadMatrix(SEXP fileName, SEXP bigMatAddr, SEXP firstLine, SEXP numLines, SEXP numCols, SEXP separator, SEXP hasRowNames, SEXP useRowNames);
-RcppExport SEXP bigmemory_ReadMatrix(SEXP fileNameSEXP, SEXP bigMatAddrSEXP, SEXP firstLineSEXP, SEXP numLinesSEXP, SEXP numColsSEXP, SEXP separatorSEXP, SEXP hasRowNamesSEXP, SEXP useRowNamesSEXP) {
+SEXP ReadMatrix(SEXP fileName, SEXP bigMatAddr, SEXP firstLine, SEXP numLines, SEXP numCols, SEXP separator, SEXP hasRowNames, SEXP useRowNames, SEXP threads, SEXP chunks);
+RcppExport SEXP bigmemory_ReadMatrix(SEXP fileNameSEXP, SEXP bigMatAddrSEXP, SEXP firstLineSEXP, SEXP numLinesSEXP, SEXP numColsSEXP, SEXP separatorSEXP, SEXP hasRowNamesSEXP, SEXP useRowNamesSEXP, SEXP threadsSEXP, SEXP chunksSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
@@ -529,13 +576,15 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type separator(separatorSEXP);
     Rcpp::traits::input_parameter< SEXP >::type hasRowNames(hasRowNamesSEXP);
     Rcpp::traits::input_parameter< SEXP >::type useRowNames(useRowNamesSEXP);
-    __result = Rcpp::wrap(ReadMatrix(fileName, bigMatAddr, firstLine, numLines, numCols, separator, hasRowNames, useRowNames));
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type chunks(chunksSEXP);
+    __result = Rcpp::wrap(ReadMatrix(fileName, bigMatAddr, firstLine, numLines, numCols, separator, hasRowNames, useRowNames, threads, chunks));
     return __result;
 END_RCPP
 }
 // WriteMatrix
-void WriteMatrix(SEXP bigMatAddr, SEXP fileName, SEXP rowNames, SEXP colNames, SEXP sep);
-RcppExport SEXP bigmemory_WriteMatrix(SEXP bigMatAddrSEXP, SEXP fileNameSEXP, SEXP rowNamesSEXP, SEXP colNamesSEXP, SEXP sepSEXP) {
+void WriteMatrix(SEXP bigMatAddr, SEXP fileName, SEXP rowNames, SEXP colNames, SEXP sep, SEXP threads);
+RcppExport SEXP bigmemory_WriteMatrix(SEXP bigMatAddrSEXP, SEXP fileNameSEXP, SEXP rowNamesSEXP, SEXP colNamesSEXP, SEXP sepSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope __rngScope;
     Rcpp::traits::input_parameter< SEXP >::type bigMatAddr(bigMatAddrSEXP);
@@ -543,7 +592,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type rowNames(rowNamesSEXP);
     Rcpp::traits::input_parameter< SEXP >::type colNames(colNamesSEXP);
     Rcpp::traits::input_parameter< SEXP >::type sep(sepSEXP);
-    WriteMatrix(bigMatAddr, fileName, rowNames, colNames, sep);
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    WriteMatrix(bigMatAddr, fileName, rowNames, colNames, sep, threads);
     return R_NilValue;
 END_RCPP
 }
@@ -691,8 +741,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // CreateFileBackedBigMatrix
-SEXP CreateFileBackedBigMatrix(SEXP fileName, SEXP filePath, SEXP row, SEXP col, SEXP colnames, SEXP rownames, SEXP typeLength, SEXP ini, SEXP separated);
-RcppExport SEXP bigmemory_CreateFileBackedBigMatrix(SEXP fileNameSEXP, SEXP filePathSEXP, SEXP rowSEXP, SEXP colSEXP, SEXP colnamesSEXP, SEXP rownamesSEXP, SEXP typeLengthSEXP, SEXP iniSEXP, SEXP separatedSEXP) {
+SEXP CreateFileBackedBigMatrix(SEXP fileName, SEXP filePath, SEXP row, SEXP col, SEXP colnames, SEXP rownames, SEXP typeLength, SEXP ini, SEXP separated, SEXP embed);
+RcppExport SEXP bigmemory_CreateFileBackedBigMatrix(SEXP fileNameSEXP, SEXP filePathSEXP, SEXP rowSEXP, SEXP colSEXP, SEXP colnamesSEXP, SEXP rownamesSEXP, SEXP typeLengthSEXP, SEXP iniSEXP, SEXP separatedSEXP, SEXP embedSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
@@ -705,7 +755,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type typeLength(typeLengthSEXP);
     Rcpp::traits::input_parameter< SEXP >::type ini(iniSEXP);
     Rcpp::traits::input_parameter< SEXP >::type separated(separatedSEXP);
-    __result = Rcpp::wrap(CreateFileBackedBigMatrix(fileName, filePath, row, col, colnames, rownames, typeLength, ini, separated));
+    Rcpp::traits::input_parameter< SEXP >::type embed(embedSEXP);
+    __result = Rcpp::wrap(CreateFileBackedBigMatrix(fileName, filePath, row, col, colnames, rownames, typeLength, ini, separated, embed));
     return __result;
 END_RCPP
 }
@@ -746,6 +797,19 @@ BEGIN_RCPP
     return __result;
 END_RCPP
 }
+// CAttachEmbeddedBigMatrix
+SEXP CAttachEmbeddedBigMatrix(SEXP fileName, SEXP filePath, SEXP readOnly);
+RcppExport SEXP bigmemory_CAttachEmbeddedBigMatrix(SEXP fileNameSEXP, SEXP filePathSEXP, SEXP readOnlySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type fileName(fileNameSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type filePath(filePathSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type readOnly(readOnlySEXP);
+    __result = Rcpp::wrap(CAttachEmbeddedBigMatrix(fileName, filePath, readOnly));
+    return __result;
+END_RCPP
+}
 // SharedName
 SEXP SharedName(SEXP address);
 RcppExport SEXP bigmemory_SharedName(SEXP addressSEXP) {
@@ -769,13 +833,14 @@ BEGIN_RCPP
 END_RCPP
 }
 // Flush
-SEXP Flush(SEXP address);
-RcppExport SEXP bigmemory_Flush(SEXP addressSEXP) {
+SEXP Flush(SEXP address, SEXP async);
+RcppExport SEXP bigmemory_Flush(SEXP addressSEXP, SEXP asyncSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
     Rcpp::traits::input_parameter< SEXP >::type address(addressSEXP);
-    __result = Rcpp::wrap(Flush(address));
+    Rcpp::traits::input_parameter< SEXP >::type async(asyncSEXP);
+    __result = Rcpp::wrap(Flush(address, async));
     return __result;
 END_RCPP
 }
@@ -790,6 +855,68 @@ BEGIN_RCPP
     return __result;
 END_RCPP
 }
+// SetMapPolicy
+SEXP SetMapPolicy(SEXP address, SEXP hugepages, SEXP prefault);
+RcppExport SEXP bigmemory_SetMapPolicy(SEXP addressSEXP, SEXP hugepagesSEXP, SEXP prefaultSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type address(addressSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type hugepages(hugepagesSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type prefault(prefaultSEXP);
+    __result = Rcpp::wrap(SetMapPolicy(address, hugepages, prefault));
+    return __result;
+END_RCPP
+}
+// GetMapPolicy
+SEXP GetMapPolicy(SEXP address);
+RcppExport SEXP bigmemory_GetMapPolicy(SEXP addressSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type address(addressSEXP);
+    __result = Rcpp::wrap(GetMapPolicy(address));
+    return __result;
+END_RCPP
+}
+// CAdvise
+SEXP CAdvise(SEXP address, SEXP pattern, SEXP rows, SEXP cols);
+RcppExport SEXP bigmemory_CAdvise(SEXP addressSEXP, SEXP patternSEXP, SEXP rowsSEXP, SEXP colsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type address(addressSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type pattern(patternSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type rows(rowsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type cols(colsSEXP);
+    __result = Rcpp::wrap(CAdvise(address, pattern, rows, cols));
+    return __result;
+END_RCPP
+}
+// CSetZoneMap
+SEXP CSetZoneMap(SEXP address, SEXP enable);
+RcppExport SEXP bigmemory_CSetZoneMap(SEXP addressSEXP, SEXP enableSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type address(addressSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type enable(enableSEXP);
+    __result = Rcpp::wrap(CSetZoneMap(address, enable));
+    return __result;
+END_RCPP
+}
+// CColumnStamp
+SEXP CColumnStamp(SEXP address, SEXP col);
+RcppExport SEXP bigmemory_CColumnStamp(SEXP addressSEXP, SEXP colSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type address(addressSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type col(colSEXP);
+    __result = Rcpp::wrap(CColumnStamp(address, col));
+    return __result;
+END_RCPP
+}
 // isnil
 SEXP isnil(SEXP address);
 RcppExport SEXP bigmemory_isnil(SEXP addressSEXP) {
@@ -801,9 +928,38 @@ BEGIN_RCPP
     return __result;
 END_RCPP
 }
+// CExportBigMatrix
+SEXP CExportBigMatrix(SEXP bigMatAddr, SEXP fileName, SEXP checksums, SEXP threads);
+RcppExport SEXP bigmemory_CExportBigMatrix(SEXP bigMatAddrSEXP, SEXP fileNameSEXP, SEXP checksumsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type bigMatAddr(bigMatAddrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type fileName(fileNameSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type checksums(checksumsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(CExportBigMatrix(bigMatAddr, fileName, checksums, threads));
+    return __result;
+END_RCPP
+}
+// CImportBigMatrix
+SEXP CImportBigMatrix(SEXP fileName, SEXP backingFile, SEXP backingPath, SEXP verify, SEXP threads);
+RcppExport SEXP bigmemory_CImportBigMatrix(SEXP fileNameSEXP, SEXP backingFileSEXP, SEXP backingPathSEXP, SEXP verifySEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject __result;
+    Rcpp::RNGScope __rngScope;
+    Rcpp::traits::input_parameter< SEXP >::type fileName(fileNameSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type backingFile(backingFileSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type backingPath(backingPathSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type verify(verifySEXP);
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(CImportBigMatrix(fileName, backingFile, backingPath, verify, threads));
+    return __result;
+END_RCPP
+}
 // CDeepCopy
-SEXP CDeepCopy(SEXP inAddr, SEXP outAddr, SEXP rowInds, SEXP colInds, SEXP typecast_warning);
-RcppExport SEXP bigmemory_CDeepCopy(SEXP inAddrSEXP, SEXP outAddrSEXP, SEXP rowIndsSEXP, SEXP colIndsSEXP, SEXP typecast_warningSEXP) {
+SEXP CDeepCopy(SEXP inAddr, SEXP outAddr, SEXP rowInds, SEXP colInds, SEXP typecast_warning, SEXP threads);
+RcppExport SEXP bigmemory_CDeepCopy(SEXP inAddrSEXP, SEXP outAddrSEXP, SEXP rowIndsSEXP, SEXP colIndsSEXP, SEXP typecast_warningSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject __result;
     Rcpp::RNGScope __rngScope;
@@ -812,7 +968,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type rowInds(rowIndsSEXP);
     Rcpp::traits::input_parameter< SEXP >::type colInds(colIndsSEXP);
     Rcpp::traits::input_parameter< SEXP >::type typecast_warning(typecast_warningSEXP);
-    __result = Rcpp::wrap(CDeepCopy(inAddr, outAddr, rowInds, colInds, typecast_warning));
+    Rcpp::traits::input_parameter< SEXP >::type threads(threadsSEXP);
+    __result = Rcpp::wrap(CDeepCopy(inAddr, outAddr, rowInds, colInds, typecast_warning, threads));
     return __result;
 END_RCPP
 }
@@ -0,0 +1,159 @@
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "bigmemory/ZoneMap.h"
+#include "bigmemory/FileIO.hpp"
+
+using namespace boost::interprocess;
+
+namespace
+{
+
+struct ZoneMapHeader
+{
+  char magic[8];
+  uint32_t byteOrder;
+  uint32_t version;
+  int32_t matrixType;
+  int32_t reserved;
+  int64_t blockRows;
+  int64_t totalRows;
+  int64_t totalCols;
+  uint64_t id;
+};
+
+const char ZONE_MAP_MAGIC[8] = {'B','I','G','Z','O','N','E','S'};
+const uint32_t ZONE_MAP_BYTE_ORDER = 0x01020304;
+const uint32_t ZONE_MAP_VERSION = 1;
+
+}
+
+bool ZoneMap::create( const std::string &fileName,
+  const index_type totalRows, const index_type totalCols,
+  const int matrixType, const index_type blockRows )
+{
+  reset();
+  ZoneMapHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ZONE_MAP_MAGIC, sizeof(ZONE_MAP_MAGIC));
+  header.byteOrder = ZONE_MAP_BYTE_ORDER;
+  header.version = ZONE_MAP_VERSION;
+  header.matrixType = matrixType;
+  header.blockRows = blockRows;
+  header.totalRows = totalRows;
+  header.totalCols = totalCols;
+  // Tells this map from earlier ones at the same path, so that anything
+  // that recorded a generation can tell it was from another map.  Kept
+  // to 52 bits so that R can hold it in a double.
+  static uint64_t serial = 0;
+  header.id = ((static_cast<uint64_t>(time(NULL)) << 24) ^
+    (static_cast<uint64_t>(getpid()) << 8) ^ ++serial) &
+    ((static_cast<uint64_t>(1) << 52) - 1);
+  index_type numBlocks = (totalRows + blockRows - 1) / blockRows;
+  index_type size = sizeof(header) + totalCols*sizeof(ZoneColumn) +
+    totalCols*numBlocks*sizeof(ZoneBlock);
+
+  // Every column starts out of date: generation 1, current 0.
+  std::vector<uint64_t> columns(2*totalCols, 0);
+  index_type i;
+  for (i=0; i < totalCols; ++i)
+  {
+    columns[2*i] = 1;
+  }
+  int fd = OpenFile(fileName, O_RDWR | O_CREAT | O_TRUNC);
+  bool ok = fd >= 0 &&
+    WriteFully(fd, reinterpret_cast<const char*>(&header), sizeof(header),
+      0) &&
+    (columns.empty() || WriteFully(fd,
+      reinterpret_cast<const char*>(&columns[0]),
+      columns.size()*sizeof(uint64_t), sizeof(header))) &&
+    ResizeFile(fd, size);
+  CloseFile(fd);
+  return ok && open(fileName, totalRows, totalCols, matrixType);
+}
+
+bool ZoneMap::open( const std::string &fileName,
+  const index_type totalRows, const index_type totalCols,
+  const int matrixType )
+{
+  reset();
+  try
+  {
+    file_mapping mFile(fileName.c_str(), read_write);
+    _pRegion = new mapped_region(mFile, read_write);
+  }
+  catch(std::exception &e)
+  {
+    reset();
+    return false;
+  }
+  ZoneMapHeader header;
+  if (_pRegion->get_size() < sizeof(header))
+  {
+    reset();
+    return false;
+  }
+  char *base = reinterpret_cast<char*>(_pRegion->get_address());
+  memcpy(&header, base, sizeof(header));
+  if (memcmp(header.magic, ZONE_MAP_MAGIC, sizeof(ZONE_MAP_MAGIC)) != 0 ||
+    header.byteOrder != ZONE_MAP_BYTE_ORDER ||
+    header.version != ZONE_MAP_VERSION || header.matrixType != matrixType ||
+    header.totalRows != totalRows || header.totalCols != totalCols ||
+    header.blockRows <= 0)
+  {
+    reset();
+    return false;
+  }
+  _totalRows = totalRows;
+  _totalCols = totalCols;
+  _blockRows = header.blockRows;
+  _id = header.id;
+  if (_pRegion->get_size() < sizeof(header) + totalCols*sizeof(ZoneColumn) +
+    totalCols*num_blocks()*sizeof(ZoneBlock))
+  {
+    reset();
+    return false;
+  }
+  _pColumns = reinterpret_cast<ZoneColumn*>(base + sizeof(header));
+  _pBlocks = reinterpret_cast<ZoneBlock*>(_pColumns + totalCols);
+  return true;
+}
+
+void ZoneMap::reset()
+{
+  delete _pRegion;
+  _pRegion = NULL;
+  _pColumns = NULL;
+  _pBlocks = NULL;
+  _totalRows = _totalCols = _blockRows = 0;
+  _id = 0;
+}
+
+uint64_t ZoneMap::generation( const index_type col ) const
+{
+  return _pColumns[col].generation;
+}
+
+bool ZoneMap::current( const index_type col ) const
+{
+  return _pColumns[col].current == _pColumns[col].generation;
+}
+
+void ZoneMap::mark_current( const index_type col, const uint64_t gen )
+{
+  if (_pColumns[col].generation == gen)
+  {
+    _pColumns[col].current = gen;
+  }
+}
+
+void ZoneMap::touch( const index_type col )
+{
+  ++(_pColumns[col].generation);
+}
@@ -0,0 +1,281 @@
+// ALTREP views of big.matrix columns.
+//
+// With options(bigmemory.altrep=TRUE), extracting columns of a read-only
+// big.matrix hands R a vector that reads the mapped data in place.  Other
+// attachments of the same data may still write to it, which is why this
+// is opt-in: a view aliases the matrix rather than taking a snapshot.
+// The columns of a double or integer matrix already hold exactly what R
+// would, so the view's data pointer is the mapped column itself.  The
+// columns of a char, short or float matrix are converted (missing values
+// and widening) only as R reads them, through Elt and Get_region, so
+// head() or a sampled read touches only the pages it needs.  Either way
+// the view keeps the big.matrix external pointer alive, and the first
+// request for a data pointer R may write through (or, for the converted
+// types, any data pointer) converts the whole range into an ordinary
+// vector that the view uses from then on.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <Rcpp.h>
+#include <Rversion.h>
+
+#include "bigmemory/BigMatrix.h"
+#include "bigmemory/MatrixAccessor.hpp"
+#include "bigmemory/ElementKernels.hpp"
+#include "bigmemory/util.h"
+
+#if defined(R_VERSION) && R_VERSION >= R_Version(3, 5, 0)
+#define BIGMEMORY_ALTREP
+#include <R_ext/Altrep.h>
+#endif
+
+#ifdef BIGMEMORY_ALTREP
+
+// The R type each element type is read as, and the missing values that
+// GetMatrixCols passes to ToRValues for it.  GetMatrixAll differs only for
+// a float matrix whose columns are not separated, where NA_FLOAT becomes
+// NA_REAL.
+template<typename CType>
+struct ColumnViewTraits;
+
+template<>
+struct ColumnViewTraits<char>
+{
+  typedef int RType;
+  static const SEXPTYPE sxpType = INTSXP;
+  static double naC() {return NA_CHAR;}
+  static double naR() {return NA_INTEGER;}
+};
+
+template<>
+struct ColumnViewTraits<short>
+{
+  typedef int RType;
+  static const SEXPTYPE sxpType = INTSXP;
+  static double naC() {return NA_SHORT;}
+  static double naR() {return NA_INTEGER;}
+};
+
+template<>
+struct ColumnViewTraits<int>
+{
+  typedef int RType;
+  static const SEXPTYPE sxpType = INTSXP;
+  static double naC() {return NA_INTEGER;}
+  static double naR() {return NA_INTEGER;}
+};
+
+template<>
+struct ColumnViewTraits<float>
+{
+  typedef double RType;
+  static const SEXPTYPE sxpType = REALSXP;
+  static double naC() {return NA_FLOAT;}
+  static double naR() {return NA_FLOAT;}
+};
+
+template<>
+struct ColumnViewTraits<double>
+{
+  typedef double RType;
+  static const SEXPTYPE sxpType = REALSXP;
+  static double naC() {return NA_REAL;}
+  static double naR() {return NA_REAL;}
+};
+
+inline int* RData( SEXP x, int* ) {return INTEGER(x);}
+inline double* RData( SEXP x, double* ) {return REAL(x);}
+
+// data1 is an external pointer to the first element, tagged with the
+// length and the R value stored for a missing one, and protecting the
+// big.matrix; data2 is the converted copy, once there is one.
+template<typename CType>
+struct ColumnView
+{
+  typedef ColumnViewTraits<CType> Traits;
+  typedef typename Traits::RType RType;
+  static R_altrep_class_t cls;
+
+  static SEXP New( SEXP bigMatAddr, CType *pData, const index_type length,
+    const double naR )
+  {
+    SEXP tag = Rf_protect(Rf_allocVector(REALSXP, 2));
+    REAL(tag)[0] = static_cast<double>(length);
+    REAL(tag)[1] = naR;
+    SEXP view = Rf_protect(R_MakeExternalPtr(pData, tag, bigMatAddr));
+    SEXP ret = R_new_altrep(cls, view, R_NilValue);
+    Rf_unprotect(2);
+    return ret;
+  }
+
+  static CType* Mapped( SEXP x )
+  {
+    return static_cast<CType*>(R_ExternalPtrAddr(R_altrep_data1(x)));
+  }
+
+  static R_xlen_t Length( SEXP x )
+  {
+    return static_cast<R_xlen_t>(REAL(R_ExternalPtrTag(R_altrep_data1(x)))[0]);
+  }
+
+  static double NaR( SEXP x )
+  {
+    return REAL(R_ExternalPtrTag(R_altrep_data1(x)))[1];
+  }
+
+  static SEXP Convert( SEXP x )
+  {
+    SEXP ret = Rf_protect(Rf_allocVector(Traits::sxpType, Length(x)));
+    ToRValues(Mapped(x), Length(x), RData(ret, static_cast<RType*>(NULL)),
+      Traits::naC(), NaR(x));
+    Rf_unprotect(1);
+    return ret;
+  }
+
+  // The data as R sees them, or NULL while they still need converting.
+  static const void* Dataptr_or_null( SEXP x )
+  {
+    SEXP copy = R_altrep_data2(x);
+    if (copy != R_NilValue) return RData(copy, static_cast<RType*>(NULL));
+    return sizeof(CType) == sizeof(RType) ?
+      static_cast<const void*>(Mapped(x)) : NULL;
+  }
+
+  static void* Dataptr( SEXP x, Rboolean writeable )
+  {
+    if (!writeable && R_altrep_data2(x) == R_NilValue &&
+      sizeof(CType) == sizeof(RType))
+    {
+      return Mapped(x);
+    }
+    if (R_altrep_data2(x) == R_NilValue)
+    {
+      R_set_altrep_data2(x, Convert(x));
+    }
+    return RData(R_altrep_data2(x), static_cast<RType*>(NULL));
+  }
+
+  static SEXP Duplicate( SEXP x, Rboolean deep )
+  {
+    SEXP copy = R_altrep_data2(x);
+    if (copy == R_NilValue) return Convert(x);
+    return Rf_duplicate(copy);
+  }
+
+  static RType Elt( SEXP x, R_xlen_t i )
+  {
+    const RType *pData = static_cast<const RType*>(Dataptr_or_null(x));
+    if (pData) return pData[i];
+    RType ret;
+    ToRValues(Mapped(x) + i, 1, &ret, Traits::naC(), NaR(x));
+    return ret;
+  }
+
+  static R_xlen_t Get_region( SEXP x, R_xlen_t i, R_xlen_t n, RType *buf )
+  {
+    R_xlen_t m = std::min(n, Length(x) - i);
+    const RType *pData = static_cast<const RType*>(Dataptr_or_null(x));
+    if (pData)
+    {
+      memcpy(buf, pData + i, m*sizeof(RType));
+    }
+    else
+    {
+      ToRValues(Mapped(x) + i, m, buf, Traits::naC(), NaR(x));
+    }
+    return m;
+  }
+
+  static void Register( R_altrep_class_t c )
+  {
+    cls = c;
+    R_set_altrep_Length_method(cls, Length);
+    R_set_altrep_Duplicate_method(cls, Duplicate);
+    R_set_altvec_Dataptr_method(cls, Dataptr);
+    R_set_altvec_Dataptr_or_null_method(cls, Dataptr_or_null);
+  }
+};
+
+template<typename CType>
+R_altrep_class_t ColumnView<CType>::cls;
+
+template<typename CType>
+void RegisterRealView( const char *name, DllInfo *dll )
+{
+  R_altrep_class_t cls = R_make_altreal_class(name, "bigmemory", dll);
+  ColumnView<CType>::Register(cls);
+  R_set_altreal_Elt_method(cls, ColumnView<CType>::Elt);
+  R_set_altreal_Get_region_method(cls, ColumnView<CType>::Get_region);
+}
+
+template<typename CType>
+void RegisterIntegerView( const char *name, DllInfo *dll )
+{
+  R_altrep_class_t cls = R_make_altinteger_class(name, "bigmemory", dll);
+  ColumnView<CType>::Register(cls);
+  R_set_altinteger_Elt_method(cls, ColumnView<CType>::Elt);
+  R_set_altinteger_Get_region_method(cls, ColumnView<CType>::Get_region);
+}
+
+template<typename CType>
+SEXP NewColumnView( SEXP bigMatAddr, BigMatrix *pMat, const index_type col,
+  const index_type numCols, const double naR=ColumnViewTraits<CType>::naR() )
+{
+  CType *pData = pMat->separated_columns() ?
+    SepMatrixAccessor<CType>(*pMat)[col] : MatrixAccessor<CType>(*pMat)[col];
+  return ColumnView<CType>::New(bigMatAddr, pData, pMat->nrow()*numCols,
+    naR);
+}
+
+#endif // BIGMEMORY_ALTREP
+
+// A vector viewing the columns col of a read-only big.matrix, or NULL if
+// they cannot be viewed: the columns must be consecutive, and more than
+// one can only be viewed when they are consecutive in memory too.  The
+// values match GetMatrixAll when whole is TRUE and GetMatrixCols
+// otherwise.
+// [[Rcpp::export]]
+SEXP GetMatrixColumnView(SEXP bigMatAddr, SEXP col, SEXP whole)
+{
+#ifdef BIGMEMORY_ALTREP
+  BigMatrix *pMat = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(bigMatAddr));
+  if (!pMat->read_only()) return R_NilValue;
+  std::vector<IndexRun> runs;
+  index_type numCols = GetIndexRuns(col, runs);
+  if (runs.size() != 1 || runs[0].first < 0) return R_NilValue;
+  if (numCols > 1 &&
+    (pMat->separated_columns() || pMat->nrow() != pMat->total_rows()))
+  {
+    return R_NilValue;
+  }
+  switch (pMat->matrix_type())
+  {
+    case 1:
+      return NewColumnView<char>(bigMatAddr, pMat, runs[0].first, numCols);
+    case 2:
+      return NewColumnView<short>(bigMatAddr, pMat, runs[0].first, numCols);
+    case 4:
+      return NewColumnView<int>(bigMatAddr, pMat, runs[0].first, numCols);
+    case 6:
+      return NewColumnView<float>(bigMatAddr, pMat, runs[0].first, numCols,
+        (LOGICAL(whole)[0] && !pMat->separated_columns()) ?
+          NA_REAL : NA_FLOAT);
+    case 8:
+      return NewColumnView<double>(bigMatAddr, pMat, runs[0].first, numCols);
+  }
+#endif
+  return R_NilValue;
+}
+
+extern "C" void R_init_bigmemory( DllInfo *dll )
+{
+#ifdef BIGMEMORY_ALTREP
+  RegisterIntegerView<char>("big_column_char", dll);
+  RegisterIntegerView<short>("big_column_short", dll);
+  RegisterIntegerView<int>("big_column_integer", dll);
+  RegisterRealView<float>("big_column_float", dll);
+  RegisterRealView<double>("big_column_real", dll);
+#endif
+}
@@ -5,7 +5,13 @@
 #include <Rcpp.h>
 #include "bigmemory/BigMatrix.h"
 #include "bigmemory/MatrixAccessor.hpp"
+#include "bigmemory/ElementKernels.hpp"
+#include "bigmemory/MWhich.hpp"
+#include "bigmemory/PermuteInPlace.hpp"
+#include "bigmemory/RadixOrder.hpp"
+#include "bigmemory/Transpose.hpp"
 #include "bigmemory/isna.hpp"
+#include "bigmemory/TextFile.hpp"
 
 #include "bigmemory/util.h"
 
@@ -48,32 +54,88 @@ bool TooManyRIndices( index_type val )
   return double(val) > pow(2.0, 31.0)-1.0;
 }
 
+// Record a write to the columns col (1-based, as seen through pMat) in
+// the matrix's zone map, if it has one.  R_NilValue stands for every
+// column.
+void TouchZoneMap( BigMatrix *pMat, SEXP col )
+{
+  FileBackedBigMatrix *pfbm = dynamic_cast<FileBackedBigMatrix*>(pMat);
+  if (!pfbm || !pfbm->zone_map()) return;
+  ZoneMap *pZoneMap = pfbm->zone_map();
+  index_type i;
+  if (Rf_isNull(col))
+  {
+    for (i=0; i < pMat->ncol(); ++i)
+    {
+      pZoneMap->touch(pMat->col_offset() + i);
+    }
+    return;
+  }
+  std::vector<double> cols;
+  GetIndices(col, cols);
+  for (i=0; i < static_cast<index_type>(cols.size()); ++i)
+  {
+    if (!isna(cols[i]))
+    {
+      pZoneMap->touch(pMat->col_offset() + 
+        static_cast<index_type>(cols[i]) - 1);
+    }
+  }
+}
+
+// The names of the n indices in runs, as an R character vector that is
+// left unprotected.
+SEXP RunNames( const Names &names, const std::vector<IndexRun> &runs,
+  const index_type n )
+{
+  SEXP ret = Rf_protect(Rf_allocVector(STRSXP, n));
+  std::vector<IndexRun>::const_iterator it;
+  index_type i, k=0;
+  for (it = runs.begin(); it != runs.end(); ++it)
+  {
+    if (it->first >= 0)
+    {
+      for (i=0; i < it->length; ++i)
+      {
+        SET_STRING_ELT( ret, k+i, Rf_mkChar(names[it->first+i].c_str()) );
+      }
+    }
+    k += it->length;
+  }
+  Rf_unprotect(1);
+  return ret;
+}
+
 template<typename CType, typename RType, typename BMAccessorType>
 void SetMatrixElements( BigMatrix *pMat, SEXP col, SEXP row, SEXP values,
   double NA_C, double C_MIN, double C_MAX, double NA_R)
 {
   BMAccessorType mat( *pMat );
-  double *pCols = REAL(col);
-  index_type numCols = Rf_length(col);
-  double *pRows = REAL(row);
-  index_type numRows = Rf_length(row);
+  std::vector<double> cols;
+  index_type numCols = GetIndices(col, cols);
   VecPtr<RType> vec_ptr;
   RType *pVals = vec_ptr(values);
   index_type valLength = Rf_length(values);
+  std::vector<IndexRun> rowRuns;
+  GetIndexRuns(row, rowRuns);
+  std::vector<IndexRun>::const_iterator it;
   index_type i=0;
-  index_type j=0;
   index_type k=0;
   CType *pColumn;
-  index_type kIndex;
   for (i=0; i < numCols; ++i)
   {
-    pColumn = mat[static_cast<index_type>(pCols[i])-1];
-    for (j=0; j < numRows; ++j)
+    pColumn = mat[static_cast<index_type>(cols[i])-1];
+    for (it = rowRuns.begin(); it != rowRuns.end(); ++it)
     {
-      kIndex = k++%valLength;
-      pColumn[static_cast<index_type>(pRows[j])-1] =
-        ((pVals[kIndex] < C_MIN || pVals[kIndex] > C_MAX) ?
-         static_cast<CType>(NA_C) : static_cast<CType>(pVals[kIndex]));
+      if (it->first >= 0)
+      {
+        RecycledFromRValues(pVals, valLength, k, pColumn + it->first,
+          it->length, NA_C, C_MIN, C_MAX);
+      }
+      else
+      {
+        k = (k + it->length) % valLength;
+      }
     }
   }
 }
@@ -142,20 +204,11 @@ void SetMatrixAll( BigMatrix *pMat, SEXP values,
   RType *pVals = vec_ptr(values);
   index_type valLength = Rf_length(values);
   index_type i=0;
-  index_type j=0;
   index_type k=0;
-  CType *pColumn;
-  index_type kIndex;
   for (i=0; i < numCols; ++i)
   {
-    pColumn = mat[i];
-    for (j=0; j < numRows; ++j)
-    {
-      kIndex = k++%valLength;
-      pColumn[j] = ((pVals[kIndex] < C_MIN || pVals[kIndex] > C_MAX) ?
-                    static_cast<CType>(NA_C) :
-                    static_cast<CType>(pVals[kIndex]));
-    }
+    RecycledFromRValues(pVals, valLength, k, mat[i], numRows, NA_C, C_MIN,
+      C_MAX);
   }
 }
 
@@ -164,27 +217,18 @@ void SetMatrixCols( BigMatrix *pMat, SEXP col, SEXP values,
   double NA_C, double C_MIN, double C_MAX, double NA_R)
 {
   BMAccessorType mat( *pMat );
-  double *pCols = REAL(col);
-  index_type numCols = Rf_length(col);
+  std::vector<double> cols;
+  index_type numCols = GetIndices(col, cols);
   index_type numRows = pMat->nrow();
   VecPtr<RType> vec_ptr;
   RType *pVals = vec_ptr(values);
   index_type valLength = Rf_length(values);
   index_type i=0;
-  index_type j=0;
   index_type k=0;
-  CType *pColumn;
-  index_type kIndex;
   for (i=0; i < numCols; ++i)
   {
-    pColumn = mat[static_cast<index_type>(pCols[i])-1];
-    for (j=0; j < numRows; ++j)
-    {  
-      kIndex = k++%valLength;
-      pColumn[j] = ((pVals[kIndex] < C_MIN || pVals[kIndex] > C_MAX) ?
-                    static_cast<CType>(NA_C) :
-                    static_cast<CType>(pVals[kIndex]));
-    }
+    RecycledFromRValues(pVals, valLength, k,
+      mat[static_cast<index_type>(cols[i])-1], numRows, NA_C, C_MIN, C_MAX);
   }
 }
 
@@ -194,25 +238,27 @@ void SetMatrixRows( BigMatrix *pMat, SEXP row, SEXP values,
 {
   BMAccessorType mat( *pMat );
   index_type numCols = pMat->ncol();
-  double *pRows = REAL(row);
-  index_type numRows = Rf_length(row);
   VecPtr<RType> vec_ptr;
   RType *pVals = vec_ptr(values);
   index_type valLength = Rf_length(values);
+  std::vector<IndexRun> rowRuns;
+  GetIndexRuns(row, rowRuns);
+  std::vector<IndexRun>::const_iterator it;
   index_type i=0;
-  index_type j=0;
   index_type k=0;
-  CType *pColumn;
-  index_type kIndex;
   for (i=0; i < numCols; ++i)
   {
-    pColumn = mat[i];
-    for (j=0; j < numRows; ++j)
+    for (it = rowRuns.begin(); it != rowRuns.end(); ++it)
     {
-      kIndex = k++%valLength;
-      pColumn[static_cast<index_type>(pRows[j])-1] =
-        ((pVals[kIndex] < C_MIN || pVals[kIndex] > C_MAX) ?
-         static_cast<CType>(NA_C) : static_cast<CType>(pVals[kIndex]));
+      if (it->first >= 0)
+      {
+        RecycledFromRValues(pVals, valLength, k, mat[i] + it->first,
+          it->length, NA_C, C_MIN, C_MAX);
+      }
+      else
+      {
+        k = (k + it->length) % valLength;
+      }
     }
   }
 }
@@ -254,10 +300,12 @@ SEXP GetMatrixElements( BigMatrix *pMat, double NA_C, double NA_R,
 {
   VecPtr<RType> vec_ptr; 
   BMAccessorType mat(*pMat);
-  double *pCols = REAL(col);
-  double *pRows = REAL(row);
-  index_type numCols = Rf_length(col);
-  index_type numRows = Rf_length(row);
+  std::vector<double> cols;
+  index_type numCols = GetIndices(col, cols);
+  // The same rows are taken from every column, so find the runs of
+  // consecutive row indices once.
+  std::vector<IndexRun> rowRuns;
+  index_type numRows = GetIndexRuns(row, rowRuns);
 /*
   if (TooManyRIndices(numCols*numRows))
   {
@@ -279,36 +327,20 @@ SEXP GetMatrixElements( BigMatrix *pMat, double NA_C, double NA_R,
   SET_VECTOR_ELT(ret, 0, retMat);
   //SEXP ret = Rf_protect( new_vec(numCols*numRows) );
   RType *pRet = vec_ptr(retMat);
-  CType *pColumn;
   index_type k=0;
-  index_type i,j;
+  index_type i;
   for (i=0; i < numCols; ++i) 
   {
-    if (isna(pCols[i]))
+    if (isna(cols[i]))
     {
-      for (j=0; j < numRows; ++j)
-      {
-        pRet[k] = static_cast<RType>(NA_R);
-      }
+      std::fill(pRet+k, pRet+k+numRows, static_cast<RType>(NA_R));
     }
     else
     {
-      pColumn = mat[static_cast<index_type>(pCols[i])-1];
-      for (j=0; j < numRows; ++j) 
-      {
-        if (isna(pRows[j]))
-        {
-          pRet[k] = static_cast<RType>(NA_R);
-        }
-        else
-        {
-          pRet[k] = (pColumn[static_cast<index_type>(pRows[j])-1] == 
-            static_cast<CType>(NA_C)) ?  static_cast<RType>(NA_R) : 
-            (static_cast<RType>(pColumn[static_cast<index_type>(pRows[j])-1]));
-        }
-        ++k;
-      }
+      RunsToRValues(mat[static_cast<index_type>(cols[i])-1], rowRuns,
+        pRet+k, NA_C, NA_R);
     }
+    k += numRows;
   }
   Names colNames = pMat->column_names();
   if (!colNames.empty())
@@ -317,9 +349,9 @@ SEXP GetMatrixElements( BigMatrix *pMat, double NA_C, double NA_R,
     SEXP rCNames = Rf_protect(Rf_allocVector(STRSXP, numCols));
     for (i=0; i < numCols; ++i)
     {
-      if (!isna(pCols[i]))
+      if (!isna(cols[i]))
         SET_STRING_ELT( rCNames, i, 
-          Rf_mkChar(colNames[static_cast<index_type>(pCols[i])-1].c_str()) );
+          Rf_mkChar(colNames[static_cast<index_type>(cols[i])-1].c_str()) );
     }
     SET_VECTOR_ELT(ret, 2, rCNames);
   }
@@ -327,16 +359,8 @@ SEXP GetMatrixElements( BigMatrix *pMat, double NA_C, double NA_R,
   if (!rowNames.empty())
   {
     ++protectCount;
-    SEXP rRNames = Rf_protect(Rf_allocVector(STRSXP, numRows));
-    for (i=0; i < numRows; ++i)
-    {
-      if (!isna(pRows[i]))
-      {
-        SET_STRING_ELT( rRNames, i, 
-          Rf_mkChar(rowNames[static_cast<index_type>(pRows[i])-1].c_str()) );  
-      }
-    }
-    SET_VECTOR_ELT(ret, 1, rRNames);
+    SET_VECTOR_ELT(ret, 1, 
+      Rf_protect(RunNames(rowNames, rowRuns, numRows)));
   }
   Rf_unprotect(protectCount);
   return ret;
@@ -399,8 +423,8 @@ SEXP GetMatrixRows( BigMatrix *pMat, double NA_C, double NA_R,
 {
   VecPtr<RType> vec_ptr; 
   BMAccessorType mat(*pMat);
-  double *pRows=REAL(row);
-  index_type numRows = Rf_length(row);
+  std::vector<IndexRun> rowRuns;
+  index_type numRows = GetIndexRuns(row, rowRuns);
   index_type numCols = pMat->ncol();
 /*
   if (TooManyRIndices(numCols*numRows))
@@ -422,26 +446,10 @@ SEXP GetMatrixRows( BigMatrix *pMat, double NA_C, double NA_R,
   ++protectCount;
   SET_VECTOR_ELT(ret, 0, retMat);
   RType *pRet = vec_ptr(retMat);
-  CType *pColumn = NULL;
-  index_type k=0;
-  index_type i,j;
+  index_type i;
   for (i=0; i < numCols; ++i) 
   {
-    pColumn = mat[i];
-    for (j=0; j < numRows; ++j) 
-    {
-      if (isna(pRows[j]))
-      {
-        pRet[k] = static_cast<RType>(NA_R);
-      }
-      else
-      {
-        pRet[k] = (pColumn[static_cast<index_type>(pRows[j])-1] == 
-          static_cast<CType>(NA_C)) ?  static_cast<RType>(NA_R) : 
-          (static_cast<RType>(pColumn[static_cast<index_type>(pRows[j])-1]));
-      }
-      ++k;
-    }
+    RunsToRValues(mat[i], rowRuns, pRet + i*numRows, NA_C, NA_R);
   }
   Names colNames = pMat->column_names();
   if (!colNames.empty())
@@ -458,16 +466,8 @@ SEXP GetMatrixRows( BigMatrix *pMat, double NA_C, double NA_R,
   if (!rowNames.empty())
   {
     ++protectCount;
-    SEXP rRNames = Rf_protect(Rf_allocVector(STRSXP, numRows));
-    for (i=0; i < numRows; ++i)
-    {
-      if (!isna(pRows[i]))
-      {
-        SET_STRING_ELT( rRNames, i, 
-          Rf_mkChar(rowNames[static_cast<index_type>(pRows[i])-1].c_str()) );  
-      }
-    }
-    SET_VECTOR_ELT(ret, 1, rRNames);
+    SET_VECTOR_ELT(ret, 1, 
+      Rf_protect(RunNames(rowNames, rowRuns, numRows)));
   }
   Rf_unprotect(protectCount);
   return ret;
@@ -479,8 +479,8 @@ SEXP GetMatrixCols( BigMatrix *pMat, double NA_C, double NA_R,
 {
   VecPtr<RType> vec_ptr; 
   BMAccessorType mat(*pMat);
-  double *pCols=REAL(col);
-  index_type numCols = Rf_length(col);
+  std::vector<double> cols;
+  index_type numCols = GetIndices(col, cols);
   index_type numRows = pMat->nrow();
 /*
   if (TooManyRIndices(numCols*numRows))
@@ -503,28 +503,20 @@ SEXP GetMatrixCols( BigMatrix *pMat, double NA_C, double NA_R,
   SET_VECTOR_ELT(ret, 0, retMat);
   //SEXP ret = Rf_protect( new_vec(numCols*numRows) );
   RType *pRet = vec_ptr(retMat);
-  CType *pColumn = NULL;
   index_type k=0;
-  index_type i,j;
+  index_type i;
   for (i=0; i < numCols; ++i) 
   {
-    if (isna(pCols[i]))
+    if (isna(cols[i]))
     {
-      for (j=0; j < numRows; ++j)
-      {
-        pRet[k] = static_cast<RType>(NA_R);
-      }
+      std::fill(pRet+k, pRet+k+numRows, static_cast<RType>(NA_R));
     }
     else
     {
-      pColumn = mat[static_cast<index_type>(pCols[i])-1];
-      for (j=0; j < numRows; ++j) 
-      {
-        pRet[k] = (pColumn[j] == static_cast<CType>(NA_C)) ?  static_cast<RType>(NA_R) : 
-                   (static_cast<RType>(pColumn[j]));
-        ++k;
-      }
+      ToRValues(mat[static_cast<index_type>(cols[i])-1], numRows, pRet+k,
+        NA_C, NA_R);
     }
+    k += numRows;
   }
   Names colNames = pMat->column_names();
   if (!colNames.empty())
@@ -533,9 +525,9 @@ SEXP GetMatrixCols( BigMatrix *pMat, double NA_C, double NA_R,
     SEXP rCNames = Rf_protect(Rf_allocVector(STRSXP, numCols));
     for (i=0; i < numCols; ++i)
     {
-      if (!isna(pCols[i]))
+      if (!isna(cols[i]))
         SET_STRING_ELT( rCNames, i, 
-          Rf_mkChar(colNames[static_cast<index_type>(pCols[i])-1].c_str()) );
+          Rf_mkChar(colNames[static_cast<index_type>(cols[i])-1].c_str()) );
     }
     SET_VECTOR_ELT(ret, 2, rCNames);
   }
@@ -583,18 +575,10 @@ SEXP GetMatrixAll( BigMatrix *pMat, double NA_C, double NA_R,
   SET_VECTOR_ELT(ret, 0, retMat);
   //SEXP ret = Rf_protect( new_vec(numCols*numRows) );
   RType *pRet = vec_ptr(retMat);
-  CType *pColumn = NULL;
-  index_type k=0;
-  index_type i,j;
+  index_type i;
   for (i=0; i < numCols; ++i) 
   {
-    pColumn = mat[i];
-    for (j=0; j < numRows; ++j) 
-    {
-      pRet[k] = (pColumn[j] == static_cast<CType>(NA_C)) ?  static_cast<RType>(NA_R) : 
-                 (static_cast<RType>(pColumn[j]));
-      ++k;
-    }
+    ToRValues(mat[i], numRows, pRet + i*numRows, NA_C, NA_R);
   }
   Names colNames = pMat->column_names();
   if (!colNames.empty())
@@ -622,198 +606,358 @@ SEXP GetMatrixAll( BigMatrix *pMat, double NA_C, double NA_R,
   return ret;
 }
 
+// Convert one field of a data file the way strtod would see it, mapping
+// NA, NaN and the infinities onto the values used by the matrix type.
+template<typename T>
+inline T ParseElement( const char *first, const char *last, double C_NA,
+  double posInf, double negInf )
+{
+  char buf[64];
+  std::string longField;
+  const char *str;
+  std::size_t len = static_cast<std::size_t>(last - first);
+  if (len < sizeof(buf))
+  {
+    memcpy(buf, first, len);
+    buf[len] = '\0';
+    str = buf;
+  }
+  else
+  {
+    longField.assign(first, last);
+    str = longField.c_str();
+  }
+  char *pEnd;
+  double d = strtod(str, &pEnd);
+  if (pEnd == str || isna(d))
+  {
+    return static_cast<T>(C_NA);
+  }
+  if (std::isinf(d))
+  {
+    return static_cast<T>( d > 0 ? posInf : negInf );
+  }
+  return static_cast<T>(d);
+}
+
+inline const char* FindSeparator( const char *first, const char *last,
+  const string &sep )
+{
+  if (sep.size() == 1)
+  {
+    const char *p = static_cast<const char*>(memchr(first, sep[0], 
+      last - first));
+    return p == NULL ? last : p;
+  }
+  for (; first < last; ++first)
+  {
+    if (sep.find(*first) != string::npos) return first;
+  }
+  return last;
+}
+
+// Parse the lines in [begin, end) into rows firstRow, firstRow+1, ... of
+// the matrix.  Rows at or beyond numRows are ignored.  Returns the index 
+// of the first row with too many entries, or -1.
+template<typename T, typename BMAccessorType>
+index_type ReadLines( BMAccessorType &mat, const char *begin, 
+  const char *end, index_type firstRow, index_type numRows, 
+  index_type numCols, const string &sep, bool hasRowNames, 
+  bool useRowNames, Names &rn, double C_NA, double posInf, double negInf )
+{
+  index_type offset = hasRowNames ? 1 : 0;
+  index_type badRow = -1;
+  index_type i = firstRow;
+  index_type j;
+  const char *lineBegin = begin;
+  while (lineBegin < end && i < numRows)
+  {
+    const char *lineEnd = static_cast<const char*>(
+      memchr(lineBegin, '\n', end - lineBegin));
+    if (lineEnd == NULL) lineEnd = end;
+    const char *first = lineBegin;
+    const char *last;
+    j = 0;
+    while (first < lineEnd)
+    {
+      last = FindSeparator(first, lineEnd, sep);
+      if (hasRowNames && 0 == j)
+      {
+        if (useRowNames)
+        {
+          string element;
+          element.reserve(last - first);
+          for (const char *p = first; p < last; ++p)
+          {
+            if (*p != '"' && *p != '\'') element.push_back(*p);
+          }
+          rn.push_back(element);
+        }
+      }
+      else if (j - offset < numCols)
+      {
+        mat[j-offset][i] = ParseElement<T>(first, last, C_NA, posInf, negInf);
+      }
+      else if (badRow < 0)
+      {
+        badRow = i;
+      }
+      ++j;
+      if (last == lineEnd) break;
+      first = last + 1;
+    }
+    for (j = std::max(j - offset, static_cast<index_type>(0)); j < numCols; 
+      ++j)
+    {
+      mat[j][i] = static_cast<T>(C_NA);
+    }
+    lineBegin = lineEnd + 1;
+    ++i;
+  }
+  return badRow;
+}
+
+// Recover the chunks found by CCountLines.  Returns false if there are 
+// none or they do not line up with the file.
+inline bool ChunksFromR( SEXP chunks, const MappedTextFile &file,
+  std::vector<const char*> &bounds, std::vector<index_type> &newlines )
+{
+  if (Rf_isNull(chunks)) return false;
+  Rcpp::List chunkList(chunks);
+  Rcpp::NumericVector offsets = chunkList["offsets"];
+  Rcpp::NumericVector chunkLines = chunkList["newlines"];
+  index_type numChunks = chunkLines.size();
+  if (numChunks < 1 || offsets.size() != numChunks+1 || offsets[0] != 0 ||
+      offsets[numChunks] != file.size())
+  {
+    return false;
+  }
+  bounds.resize(numChunks+1);
+  newlines.resize(numChunks);
+  index_type i;
+  for (i=0; i <= numChunks; ++i)
+  {
+    bounds[i] = file.begin() + static_cast<index_type>(offsets[i]);
+    if (i > 0 && (bounds[i] <= bounds[i-1] || 
+        (i < numChunks && *(bounds[i]-1) != '\n')))
+    {
+      return false;
+    }
+  }
+  for (i=0; i < numChunks; ++i)
+  {
+    newlines[i] = static_cast<index_type>(chunkLines[i]);
+  }
+  return true;
+}
+
 template<typename T, typename BMAccessorType>
 SEXP ReadMatrix(SEXP fileName, BigMatrix *pMat,
                 SEXP firstLine, SEXP numLines, SEXP numCols, SEXP separator,
-                SEXP hasRowNames, SEXP useRowNames, double C_NA, double posInf, 
-                double negInf, double notANumber)
+                SEXP hasRowNames, SEXP useRowNames, SEXP threads, 
+                SEXP chunks, double C_NA, double posInf, double negInf)
 {
   BMAccessorType mat(*pMat);
   SEXP ret = Rf_protect(Rf_allocVector(LGLSXP, 1));
   LOGICAL(ret)[0] = (Rboolean)0;
   index_type fl = static_cast<index_type>(REAL(firstLine)[0]);
   index_type nl = static_cast<index_type>(REAL(numLines)[0]);
+  index_type nc = pMat->ncol();
   string sep(CHAR(STRING_ELT(separator,0)));
-  index_type i=0,j;
-  bool rowSizeReserved = false;
-  //double val;
+  bool hrn = LOGICAL(hasRowNames)[0];
+  bool urn = hrn && LOGICAL(useRowNames)[0];
+  int numThreads = std::max(Rf_asInteger(threads), 1);
+  index_type i, j;
 
-  ifstream file;
-  string lc, element;
-  file.open(CHAR(Rf_asChar(fileName)));
-  if (!file.is_open())
+  MappedTextFile file;
+  if (!file.open(CHAR(Rf_asChar(fileName))))
   {
     Rf_unprotect(1);
     return ret;
   }
-  for (i=0; i < fl; ++i)
+
+  // The file is processed in the newline-aligned chunks found by 
+  // CCountLines, if they are given and still fit the file, and the line 
+  // counts of the chunks tell each one the row it starts at.  The chunks
+  // are then parsed independently.
+  std::vector<const char*> bounds;
+  std::vector<index_type> newlines;
+  if (!ChunksFromR(chunks, file, bounds, newlines))
   {
-    std::getline(file, lc);
+    ScanLines(file.begin(), file.end(), 
+      NumTextChunks(file.size(), numThreads), numThreads, bounds, newlines);
   }
+  index_type numChunks = static_cast<index_type>(newlines.size());
+  std::vector<index_type> chunkRows(numChunks+1, 0);
+  std::vector<index_type> badRows(numChunks, -1);
+  std::vector<Names> chunkNames(numChunks);
+  index_type line = 0;
+  for (i=0; i < numChunks; ++i)
+  {
+    // The first fl lines are skipped.
+    chunkRows[i] = line - fl;
+    if (line < fl && line + newlines[i] >= fl)
+    {
+      bounds[i] = SkipLines(bounds[i], bounds[i+1], fl - line);
+      chunkRows[i] = 0;
+    }
+    line += newlines[i];
+  }
+  if (numChunks > 0 && bounds[numChunks] > bounds[numChunks-1] && 
+      *(bounds[numChunks]-1) != '\n')
+  {
+    ++line;
+  }
+  chunkRows[numChunks] = line - fl;
+
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+#endif
+  for (i=0; i < numChunks; ++i)
+  {
+    if (chunkRows[i] < nl && chunkRows[i+1] > 0)
+    {
+      badRows[i] = ReadLines<T, BMAccessorType>(mat, bounds[i], bounds[i+1], 
+        chunkRows[i], nl, nc, sep, hrn, urn, chunkNames[i], C_NA, posInf, 
+        negInf);
+    }
+  }
+
+  // Lines past the end of the file are missing.
+  for (i=std::max(chunkRows[numChunks], static_cast<index_type>(0)); i < nl; 
+    ++i)
+  {
+    for (j=0; j < nc; ++j)
+    {
+      mat[j][i] = static_cast<T>(C_NA);
+    }
+  }
+
   Names rn;
-  index_type offset = static_cast<index_type>(LOGICAL(hasRowNames)[0]);
-  double d;
-  int charRead;
-  char *pEnd;
-  for (i=0; i < nl; ++i)
+  if (urn)
+  {
+    rn.reserve(nl);
+    for (i=0; i < numChunks; ++i)
+    {
+      rn.insert(rn.end(), chunkNames[i].begin(), chunkNames[i].end());
+    }
+  }
+  pMat->row_names( rn );
+  for (i=0; i < numChunks; ++i)
+  {
+    if (badRows[i] >= 0)
+    {
+      Rf_warning( 
+        (string("Incorrect number of entries in row ")+
+         ttos(badRows[i]+1)).c_str());
+      break;
+    }
+  }
+  LOGICAL(ret)[0] = (Rboolean)1;
+  Rf_unprotect(1);
+  return ret;
+}
+
+// Format rows [firstRow, lastRow) onto the end of out.
+template<typename T, typename BMAccessorType>
+void FormatRows( BMAccessorType &mat, index_type firstRow, 
+  index_type lastRow, index_type numCols, const Names &rn, 
+  const string &sepString, string &out )
+{
+  char buf[32];
+  index_type i, j;
+  for (i=firstRow; i < lastRow; ++i)
   {
-    // getline may be slow
-    std::getline(file, lc);
-    string::size_type first=0, last=0;
-    j=0;
-    while (first < lc.size() && last < lc.size())
+    if (!rn.empty())
     {
-      last = lc.find_first_of(sep, first);
-      element = lc.substr(first, last-first);
-      if (LOGICAL(hasRowNames)[0] && 0==j)
+      out += '"';
+      out += rn[i];
+      out += '"';
+      out += sepString;
+    }
+    for (j=0; j < numCols; ++j)
+    {
+      T val = mat[j][i];
+      if ( isna(val) )
       {
-        if (LOGICAL(useRowNames)[0])
-        {
-          if (!rowSizeReserved)
-          {
-            rn.reserve(nl);
-            rowSizeReserved = true;
-          }
-          std::size_t pos;
-          while ( (pos = element.find("\"", 0)) != string::npos )
-          {
-            element = element.replace(pos, 1, "");
-          }
-          while ( (pos = element.find("'", 0)) != string::npos )
-          {
-            element = element.replace(pos, 1, "");
-          }
-          rn.push_back(element);
-        }
+        out += "NA";
       }
       else
       {
-        if (j-offset < pMat->ncol()+1)
-        {
-          d = strtod(element.c_str(), &pEnd);
-          if (pEnd != element.c_str())
-          {
-            if (isna(d))
-            {
-              mat[j-offset][i] = static_cast<T>(C_NA);
-            }
-            else if (std::isinf(d) && d > 0)
-            {
-              mat[j-offset][i] = static_cast<T>(posInf);
-            }
-            else if (std::isinf(d) && d < 0) 
-            {
-              mat[j-offset][i] = static_cast<T>(negInf);
-            }
-            else
-            {
-              mat[j-offset][i] = static_cast<T>(d);
-            }
-          }
-          else
-          {
-            charRead = sscanf(element.c_str(), "%lf", &d);
-            if (charRead == static_cast<int>(element.size()))
-            {
-              mat[j-offset][i] = static_cast<T>(d);
-            }
-            else if (element == "NA")
-            {
-              mat[j-offset][i] = static_cast<T>(C_NA);
-            }
-            else if (element == "inf" || element == "Inf")
-            {
-              mat[j-offset][i] = static_cast<T>(posInf);
-            }
-            else if (element == "-inf" || element == "-Inf")
-            {
-              mat[j-offset][i] = static_cast<T>(negInf);
-            }
-            else if (element == "NaN")
-            {
-              mat[j-offset][i] = static_cast<T>(notANumber);
-            }
-            else if (element =="")
-            {
-              mat[j-offset][i] = static_cast<T>(C_NA);
-            }
-            else
-            {
-              mat[j-offset][i] = static_cast<T>(C_NA);
-            }
-          }
-        }
-        else
-        {
-          Rf_warning( 
-            (string("Incorrect number of entries in row ")+ttos(j)).c_str());
-        }
+        out.append(buf, FormatNumber(buf, val));
       }
-      first = last+1;
-      ++j;
-    }
-    if (j-offset < pMat->ncol())
-    {
-//      warning( (string("Incorrect number of entries in row ")+ttos(j)).c_str());
-      while (j-offset < pMat->ncol())
+      if (j < numCols-1)
       {
-        mat[j++ - offset][i] = static_cast<T>(C_NA);
+        out += sepString;
       }
     }
+    out += '\n';
   }
-  pMat->row_names( rn );
-  file.close();
-  LOGICAL(ret)[0] = (Rboolean)1;
-  Rf_unprotect(1);
-  return ret;
 }
 
+// Rows are formatted a block at a time into buffers that are kept for
+// the whole write, so the only allocations are the first few times the
+// buffers grow.  With more than one thread, a round of blocks is 
+// formatted in parallel and then written out in order.
 template<typename T, typename BMAccessorType>
 void WriteMatrix( BigMatrix *pMat, SEXP fileName, SEXP rowNames,
-                  SEXP colNames, SEXP sep, double C_NA )
+                  SEXP colNames, SEXP sep, SEXP threads, double C_NA )
 {
   BMAccessorType mat(*pMat);
   FILE *FP = fopen(CHAR(Rf_asChar(fileName)), "w");
-  index_type i,j;
+  if (FP == NULL)
+  {
+    Rf_error("Could not open %s for writing.", CHAR(Rf_asChar(fileName)));
+  }
+  index_type i;
   string  s;
   string sepString = string(CHAR(STRING_ELT(sep, 0)));
+  int numThreads = std::max(Rf_asInteger(threads), 1);
 
   Names cn = pMat->column_names();
-  Names rn = pMat->row_names();
+  Names rn;
+  if (LOGICAL(rowNames)[0] == Rboolean(TRUE))
+  {
+    rn = pMat->row_names();
+    if (static_cast<index_type>(rn.size()) < pMat->nrow())
+    {
+      rn.clear();
+    }
+  }
   if (LOGICAL(colNames)[0] == Rboolean(TRUE) && !cn.empty())
   {
     for (i=0; i < (int) cn.size(); ++i)
       s += "\"" + cn[i] + "\"" + (((int)cn.size()-1 == i) ? "\n" : sepString);
   }
-  fprintf(FP, "%s", s.c_str());
-  s.clear();
-  for (i=0; i < pMat->nrow(); ++i) 
+  fwrite(s.data(), 1, s.size(), FP);
+
+  const index_type numRows = pMat->nrow();
+  const index_type numCols = pMat->ncol();
+  const index_type blockRows = std::max(static_cast<index_type>(1), 
+    static_cast<index_type>(1 << 16) / std::max(numCols, 
+      static_cast<index_type>(1)));
+  const index_type numBuffers = numThreads > 1 ? 4 * numThreads : 1;
+  std::vector<string> buffers(numBuffers);
+  index_type firstRow, b, numBlocks;
+  for (firstRow=0; firstRow < numRows; firstRow += numBuffers*blockRows)
   {
-    if ( LOGICAL(rowNames)[0] == Rboolean(TRUE) && !rn.empty())
+    numBlocks = std::min(numBuffers, 
+      (numRows - firstRow + blockRows - 1) / blockRows);
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+#endif
+    for (b=0; b < numBlocks; ++b)
     {
-      s += "\"" + rn[i] + "\"" + sepString;
+      index_type blockStart = firstRow + b*blockRows;
+      buffers[b].clear();
+      FormatRows<T, BMAccessorType>(mat, blockStart, 
+        std::min(blockStart + blockRows, numRows), numCols, rn, sepString, 
+        buffers[b]);
     }
-    for (j=0; j < pMat->ncol(); ++j) 
+    for (b=0; b < numBlocks; ++b)
     {
-      if ( isna(mat[j][i]) )
-      {
-        s += "NA";
-      }
-      else
-      {
-        s += ttos(mat[j][i]);
-      }
-      if (j < pMat->ncol()-1)
-      { 
-        s += sepString;
-      }
-      else 
-      {
-        s += "\n";
-      }
+      fwrite(buffers[b].data(), 1, buffers[b].size(), FP);
     }
-    fprintf(FP, "%s", s.c_str());
-    s.clear();
   }
   fclose(FP);
 }
@@ -836,55 +980,6 @@ struct NAMaker<int>
 template<>
 struct NAMaker<double>
 {double operator()() const {return NA_REAL;}};
-// Note: naLast should be passed as an integer.
-
-template<typename PairType>
-struct SecondLess : public std::binary_function<PairType, PairType, bool>
-{
-  SecondLess( const bool naLast ) : _naLast(naLast) {}
-
-  bool operator()(const PairType &lhs, const PairType &rhs) const
-  {
-    if (_naLast)
-    {
-      if (isna(lhs.second) || isna(rhs.second)) return false;
-      return lhs.second < rhs.second;
-    }
-    else
-    {
-      if (isna(lhs.second)) return true;
-      if (isna(rhs.second)) return false;
-      return lhs.second < rhs.second;
-    }
-  }
-  
-  bool _naLast;
-
-};
-
-template<typename PairType>
-struct SecondGreater : public std::binary_function<PairType, PairType, bool>
-{
-  SecondGreater(const bool naLast ) : _naLast(naLast) {}
-
-  bool operator()(const PairType &lhs, const PairType &rhs) const
-  {
-    if (_naLast)
-    {
-      if (isna(lhs.second) || isna(rhs.second)) return false;
-      return lhs.second > rhs.second;
-    }
-    else
-    {
-      if (isna(lhs.second)) return true;
-      if (isna(rhs.second)) return false;
-      return lhs.second > rhs.second;
-    }
-  }
-
-  bool _naLast;
-
-};
 
 template<typename PairType>
 struct SecondIsNA : public std::unary_function<PairType, bool>
@@ -902,21 +997,39 @@ void reorder_matrix( MatrixAccessorType m, SEXP orderVec,
   double *pov = REAL(orderVec);
   typedef typename MatrixAccessorType::value_type ValueType;
   typedef std::vector<ValueType> Values;
-  Values vs(m.nrow());
   index_type i,j;
-  for (i=0; i < numColumns; ++i)
+  std::vector<bool> marks;
+  if (IsPermutation(pov, m.nrow(), marks))
   {
-    for (j=0; j < m.nrow(); ++j)
+    for (i=0; i < numColumns; i += PERMUTE_BLOCK_COLS)
     {
-      vs[j] = m[i][static_cast<index_type>(pov[j])-1];
+      j = std::min(i+PERMUTE_BLOCK_COLS, numColumns);
+      PermuteRowsInPlace(m, pov, i, j, marks);
+      // Start writing these columns back; the one durable sync comes at
+      // the end.
+      if (pfbm) pfbm->flush(0, m.nrow(), i, j, true);
     }
-    std::copy( vs.begin(), vs.end(), m[i] );
-    if (pfbm) pfbm->flush();
   }
+  else
+  {
+    // An order with repeats (allow.duplicates=TRUE) is not a permutation
+    // and has to be gathered through a copy of each column.
+    Values vs(m.nrow());
+    for (i=0; i < numColumns; ++i)
+    {
+      for (j=0; j < m.nrow(); ++j)
+      {
+        vs[j] = m[i][static_cast<index_type>(pov[j])-1];
+      }
+      std::copy( vs.begin(), vs.end(), m[i] );
+      if (pfbm) pfbm->flush(0, m.nrow(), i, i+1, true);
+    }
+  }
+  if (pfbm) pfbm->flush(0, m.nrow(), 0, numColumns);
+  if (pfbm) TouchZoneMap(pfbm, R_NilValue);
 }
 
 // Function to reorder columns
-// It likely could use improvement as it just goes element by element
 // Added 9-17-2015 by Charles Determan
 template<typename MatrixAccessorType>
 void reorder_matrix2( MatrixAccessorType m, SEXP orderVec, 
@@ -925,199 +1038,118 @@ void reorder_matrix2( MatrixAccessorType m, SEXP orderVec,
   double *pov = REAL(orderVec);
   typedef typename MatrixAccessorType::value_type ValueType;
   typedef std::vector<ValueType> Values;
-  Values vs(m.ncol());
   index_type i,j;
-  
-  for (j=0; j < numRows; ++j)
+  std::vector<bool> marks;
+  if (IsPermutation(pov, m.ncol(), marks))
   {
-    for (i=0; i < m.ncol(); ++i)
-    {           
-      vs[i] = m[static_cast<index_type>(pov[i])-1][j];
-    }
-    for(i = 0; i < m.ncol(); ++i)
-    {
-      m[i][j] = vs[i];
-    }
-    if (pfbm) pfbm->flush();
+    PermuteColumnsInPlace(m, pov, numRows);
   }
-}
-
-template<typename RType, typename MatrixAccessorType>
-SEXP get_order( MatrixAccessorType m, SEXP columns, SEXP naLast,
-  SEXP decreasing )
-{
-  typedef typename MatrixAccessorType::value_type ValueType;
-  typedef typename std::pair<double, ValueType> PairType;
-  typedef std::vector<PairType> OrderVecs;
-  std::size_t i;
-  index_type k;
-  index_type col;
-  OrderVecs ov;
-  ov.reserve(m.nrow());
-  typename OrderVecs::iterator begin, end, it, naIt;
-  ValueType val;
-  for (k=Rf_length(columns)-1; k >= 0; --k)
+  else
   {
-    col = static_cast<index_type>(REAL(columns)[k]-1);
-    if (k==Rf_length(columns)-1)
-    {
-      if (isna(Rf_asInteger(naLast)))
-      {
-        for (i=0; i < static_cast<size_t>(m.nrow()); ++i)
-        {
-          val = m[col][i];
-          if (!isna(val)) 
-          {
-            ov.push_back( std::make_pair( static_cast<double>(i), val) );
-          }
-        }
-      }
-      else
-      {
-        ov.resize(m.nrow());
-        for (i=0; i < static_cast<size_t>(m.nrow()); ++i)
-        {
-          val = m[col][i];
-          ov[i].first = i;
-          ov[i].second = val;
-        }
-      }
-    }
-    else // not the first column we've looked at
+    Values vs(m.ncol());
+    for (j=0; j < numRows; ++j)
     {
-      if (isna(Rf_asInteger(naLast)))
-      {
-        i=0;
-        while (i < ov.size())
-        {
-          val = m[col][static_cast<index_type>(ov[i].first)];
-          if (!isna(val)) 
-          {
-            ov[i++].second = val;
-          }
-          else
-          {
-            ov.erase(ov.begin()+i);
-          }
-        }
+      for (i=0; i < m.ncol(); ++i)
+      {           
+        vs[i] = m[static_cast<index_type>(pov[i])-1][j];
       }
-      else
+      for(i = 0; i < m.ncol(); ++i)
       {
-        for (i=0; i < static_cast<size_t>(m.nrow()); ++i)
-        {
-          ov[i].second = m[col][static_cast<index_type>(ov[i].first)];
-        }
+        m[i][j] = vs[i];
       }
     }
-    if (LOGICAL(decreasing)[0] == 0)
+  }
+  // Columns are moved a block of rows at a time, so there is nothing to
+  // gain from flushing as we go.
+  if (pfbm) pfbm->flush(0, numRows, 0, m.ncol());
+  if (pfbm) TouchZoneMap(pfbm, R_NilValue);
+}
+
+// The order of 0, ..., n-1 by keys[0], then keys[1], and so on, as
+// 1-based numbers.  naLast is as for R's order(): NA drops anything with
+// a missing key.
+template<typename IndexT, typename KeyFunc>
+SEXP radix_order( const std::vector<KeyFunc> &keys, index_type n,
+  int naLast, bool decreasing, int numThreads )
+{
+  std::vector<IndexT> perm(n);
+  index_type i;
+  for (i=0; i < n; ++i)
+  {
+    perm[i] = static_cast<IndexT>(i);
+  }
+  int k;
+  if (isna(naLast))
+  {
+    for (k=0; k < static_cast<int>(keys.size()); ++k)
     {
-      std::stable_sort(ov.begin(), ov.end(), 
-        SecondLess<PairType>(Rf_asInteger(naLast)) );
+      RadixDropNA(perm, keys[k]);
     }
-    else
+  }
+  // Small orders aren't worth the threads.
+  if (numThreads > 1 && perm.size() >= 65536)
+  {
+    ParallelRadixOrder(perm, keys, decreasing, naLast != 0, numThreads);
+  }
+  else
+  {
+    for (k=static_cast<int>(keys.size())-1; k >= 0; --k)
     {
-      std::stable_sort(ov.begin(), ov.end(), 
-        SecondGreater<PairType>(Rf_asInteger(naLast)));
+      RadixOrderBy(perm, keys[k], decreasing, naLast != 0);
     }
   }
-
-  SEXP ret = Rf_protect(Rf_allocVector(REALSXP,ov.size()));
+  SEXP ret = Rf_protect(Rf_allocVector(REALSXP, perm.size()));
   double *pret = REAL(ret);
-  for (i=0, it=ov.begin(); it < ov.end(); ++it, ++i)
+  for (i=0; i < static_cast<index_type>(perm.size()); ++i)
   {
-    pret[i] = it->first+1;
+    pret[i] = static_cast<double>(perm[i]) + 1;
   }
   Rf_unprotect(1);
   return ret;
 }
 
+// Orders of up to 2^32 elements are kept as 32-bit integers.
+template<typename KeyFunc>
+SEXP radix_order( const std::vector<KeyFunc> &keys, index_type n,
+  SEXP naLast, SEXP decreasing, int numThreads )
+{
+  if (n <= static_cast<index_type>(std::numeric_limits<uint32_t>::max()))
+  {
+    return radix_order<uint32_t>(keys, n, Rf_asInteger(naLast),
+      LOGICAL(decreasing)[0] != 0, numThreads);
+  }
+  return radix_order<index_type>(keys, n, Rf_asInteger(naLast),
+    LOGICAL(decreasing)[0] != 0, numThreads);
+}
+
 template<typename RType, typename MatrixAccessorType>
-SEXP get_order2( MatrixAccessorType m, SEXP rows, SEXP naLast,
-  SEXP decreasing )
+SEXP get_order( MatrixAccessorType m, SEXP columns, SEXP naLast,
+  SEXP decreasing, SEXP threads )
 {
   typedef typename MatrixAccessorType::value_type ValueType;
-  typedef typename std::pair<double, ValueType> PairType;
-  typedef std::vector<PairType> OrderVecs;
-  std::size_t i;
+  std::vector< ColumnKey<ValueType> > keys;
   index_type k;
-  index_type row;
-  OrderVecs ov;
-  ov.reserve(m.ncol());
-  typename OrderVecs::iterator begin, end, it, naIt;
-  ValueType val;
-  for (k=Rf_length(rows)-1; k >= 0; --k)
+  for (k=0; k < Rf_length(columns); ++k)
   {
-    row = static_cast<index_type>(REAL(rows)[k]-1);
-    if (k==Rf_length(rows)-1)
-    {
-      if (isna(Rf_asInteger(naLast)))
-      {
-        for (i=0; i < static_cast<size_t>(m.ncol()); ++i)
-        {
-          val = m[row][i];
-          if (!isna(val)) 
-          {
-            ov.push_back( std::make_pair( static_cast<double>(i), val) );
-          }
-        }
-      }
-      else
-      {
-        ov.resize(m.ncol());
-        for (i=0; i < static_cast<size_t>(m.ncol()); ++i)
-        {
-          val = m[i][row];
-          ov[i].first = i;
-          ov[i].second = val;
-        }
-      }
-    }
-    else // not the first column we've looked at
-    {
-      if (isna(Rf_asInteger(naLast)))
-      {
-        i=0;
-        while (i < ov.size())
-        {
-          val = m[static_cast<index_type>(ov[i].first)][row];
-          if (!isna(val)) 
-          {
-            ov[i++].second = val;
-          }
-          else
-          {
-            ov.erase(ov.begin()+i);
-          }
-        }
-      }
-      else
-      {
-        for (i=0; i < static_cast<size_t>(m.ncol()); ++i)
-        {
-          ov[i].second = m[static_cast<index_type>(ov[i].first)][row];
-        }
-      }
-    }
-    if (LOGICAL(decreasing)[0] == 0)
-    {
-      std::stable_sort(ov.begin(), ov.end(), 
-        SecondLess<PairType>(Rf_asInteger(naLast)) );
-    }
-    else
-    {
-      std::stable_sort(ov.begin(), ov.end(), 
-        SecondGreater<PairType>(Rf_asInteger(naLast)));
-    }
+    keys.push_back(ColumnKey<ValueType>(
+      m[static_cast<index_type>(REAL(columns)[k]-1)]));
   }
+  return radix_order(keys, m.nrow(), naLast, decreasing, 
+    std::max(Rf_asInteger(threads), 1));
+}
 
-  SEXP ret = Rf_protect(Rf_allocVector(REALSXP,ov.size()));
-  double *pret = REAL(ret);
-  for (i=0, it=ov.begin(); it < ov.end(); ++it, ++i)
+template<typename RType, typename MatrixAccessorType>
+SEXP get_order2( MatrixAccessorType m, SEXP rows, SEXP naLast,
+  SEXP decreasing )
+{
+  std::vector< RowKey<MatrixAccessorType> > keys;
+  index_type k;
+  for (k=0; k < Rf_length(rows); ++k)
   {
-    pret[i] = it->first+1;
+    keys.push_back(RowKey<MatrixAccessorType>(m, 
+      static_cast<index_type>(REAL(rows)[k]-1)));
   }
-  Rf_unprotect(1);
-  return ret;
+  return radix_order(keys, m.ncol(), naLast, decreasing, 1);
 }
 
 
@@ -1217,6 +1249,21 @@ void ReorderBigMatrixCols( SEXP address, SEXP orderVec )
   BigMatrix *pMat = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(address));
   if (pMat->separated_columns())
   {
+    // The separated columns of a non-shared matrix are reordered by
+    // reordering its column pointers, unless the order has repeats.
+    // Anything another object may be attached to moves the data, so that
+    // every attachment sees the new order.
+    std::vector<bool> marks;
+    if (!pMat->shared() && IsPermutation(REAL(orderVec), pMat->ncol(), marks))
+    {
+      Columns order(pMat->ncol());
+      index_type i;
+      for (i=0; i < pMat->ncol(); ++i)
+      {
+        order[i] = static_cast<index_type>(REAL(orderVec)[i]) - 1;
+      }
+      if (pMat->permute_columns(order)) return;
+    }
     switch (pMat->matrix_type())
     {
       case 1:
@@ -1259,28 +1306,129 @@ void ReorderBigMatrixCols( SEXP address, SEXP orderVec )
   }
 }
 
+// Transpose in into out a TRANSPOSE_BLOCK square at a time.  Each block of
+// a file-backed matrix is written back and released as soon as it is done,
+// so only a block or two of either matrix is resident at once.
+template<typename InAccessorType, typename OutAccessorType>
+void transpose_matrix( InAccessorType in, OutAccessorType out,
+  BigMatrix *pIn, BigMatrix *pOut, const int numThreads )
+{
+  FileBackedBigMatrix *pfbIn = dynamic_cast<FileBackedBigMatrix*>(pIn);
+  FileBackedBigMatrix *pfbOut = dynamic_cast<FileBackedBigMatrix*>(pOut);
+  index_type i0, i1, j0, j1;
+  for (i0=0; i0 < in.nrow(); i0 += TRANSPOSE_BLOCK)
+  {
+    i1 = std::min(i0 + TRANSPOSE_BLOCK, in.nrow());
+    for (j0=0; j0 < in.ncol(); j0 += TRANSPOSE_BLOCK)
+    {
+      j1 = std::min(j0 + TRANSPOSE_BLOCK, in.ncol());
+      TransposeBlock(in, out, i0, i1, j0, j1, numThreads);
+      if (pfbOut)
+      {
+        pfbOut->flush(j0, j1, i0, i1, true);
+        pfbOut->advise(SharedBigMatrix::ADVICE_DONTNEED, j0, j1, i0, i1);
+      }
+      if (pfbIn)
+      {
+        pfbIn->advise(SharedBigMatrix::ADVICE_DONTNEED, i0, i1, j0, j1);
+      }
+    }
+  }
+  if (pfbOut) pfbOut->flush(0, out.nrow(), 0, out.ncol());
+}
+
+template<typename T>
+void TransposeBigMatrix( BigMatrix *pIn, BigMatrix *pOut,
+  const int numThreads )
+{
+  if (pIn->separated_columns())
+  {
+    if (pOut->separated_columns())
+    {
+      transpose_matrix( SepMatrixAccessor<T>(*pIn),
+        SepMatrixAccessor<T>(*pOut), pIn, pOut, numThreads );
+    }
+    else
+    {
+      transpose_matrix( SepMatrixAccessor<T>(*pIn),
+        MatrixAccessor<T>(*pOut), pIn, pOut, numThreads );
+    }
+  }
+  else
+  {
+    if (pOut->separated_columns())
+    {
+      transpose_matrix( MatrixAccessor<T>(*pIn),
+        SepMatrixAccessor<T>(*pOut), pIn, pOut, numThreads );
+    }
+    else
+    {
+      transpose_matrix( MatrixAccessor<T>(*pIn),
+        MatrixAccessor<T>(*pOut), pIn, pOut, numThreads );
+    }
+  }
+}
+
+// Fill outAddr, which must have the type of inAddr and its dimensions
+// swapped, with the transpose of inAddr.
+// [[Rcpp::export]]
+void CTranspose( SEXP inAddr, SEXP outAddr, SEXP threads )
+{
+  BigMatrix *pIn = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(inAddr));
+  BigMatrix *pOut = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(outAddr));
+  if (pIn->matrix_type() != pOut->matrix_type())
+  {
+    Rf_error("The matrices must have the same type.");
+  }
+  if (pIn->nrow() != pOut->ncol() || pIn->ncol() != pOut->nrow())
+  {
+    Rf_error("The dimensions of the result do not match the transpose.");
+  }
+  int numThreads = std::max(Rf_asInteger(threads), 1);
+  switch (pIn->matrix_type())
+  {
+    case 1:
+      TransposeBigMatrix<char>(pIn, pOut, numThreads);
+      break;
+    case 2:
+      TransposeBigMatrix<short>(pIn, pOut, numThreads);
+      break;
+    case 4:
+      TransposeBigMatrix<int>(pIn, pOut, numThreads);
+      break;
+    case 6:
+      TransposeBigMatrix<float>(pIn, pOut, numThreads);
+      break;
+    case 8:
+      TransposeBigMatrix<double>(pIn, pOut, numThreads);
+      break;
+  }
+  TouchZoneMap(pOut, R_NilValue);
+}
+
 // [[Rcpp::export]]
 SEXP OrderRIntMatrix( SEXP matrixVector, SEXP nrow, SEXP columns,
-  SEXP naLast, SEXP decreasing )
+  SEXP naLast, SEXP decreasing, SEXP threads )
 {
   return get_order<int>( 
     MatrixAccessor<int>(INTEGER(matrixVector), 
       static_cast<index_type>(Rf_asInteger(nrow))), 
-    columns, naLast, decreasing );
+    columns, naLast, decreasing, threads );
 }
 
 // [[Rcpp::export]]
 SEXP OrderRNumericMatrix( SEXP matrixVector, SEXP nrow, SEXP columns,
-  SEXP naLast, SEXP decreasing )
+  SEXP naLast, SEXP decreasing, SEXP threads )
 {
   return get_order<double>( 
     MatrixAccessor<double>(REAL(matrixVector), 
       static_cast<index_type>(Rf_asInteger(nrow))), 
-    columns, naLast, decreasing );
+    columns, naLast, decreasing, threads );
 }
 
 // [[Rcpp::export]]
-SEXP OrderBigMatrix(SEXP address, SEXP columns, SEXP naLast, SEXP decreasing)
+SEXP OrderBigMatrix(SEXP address, SEXP columns, SEXP naLast, SEXP decreasing,
+  SEXP threads)
 {
   BigMatrix *pMat = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(address));
   if (pMat->separated_columns())
@@ -1289,19 +1437,19 @@ SEXP OrderBigMatrix(SEXP address, SEXP columns, SEXP naLast, SEXP decreasing)
     {
       case 1:
         return get_order<char>( SepMatrixAccessor<char>(*pMat), 
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
       case 2:
         return get_order<short>( SepMatrixAccessor<short>(*pMat), 
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
       case 4:
         return get_order<int>( SepMatrixAccessor<int>(*pMat),
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
       case 6:
         return get_order<float>( SepMatrixAccessor<float>(*pMat),
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
       case 8:
         return get_order<double>( SepMatrixAccessor<double>(*pMat),
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
     }
   }
   else
@@ -1310,19 +1458,19 @@ SEXP OrderBigMatrix(SEXP address, SEXP columns, SEXP naLast, SEXP decreasing)
     {
       case 1:
         return get_order<char>( MatrixAccessor<char>(*pMat),
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
       case 2:
         return get_order<short>( MatrixAccessor<short>(*pMat),
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
       case 4:
         return get_order<int>( MatrixAccessor<int>(*pMat),
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
       case 6:
         return get_order<float>( MatrixAccessor<float>(*pMat),
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
       case 8:
         return get_order<double>( MatrixAccessor<double>(*pMat),
-          columns, naLast, decreasing );
+          columns, naLast, decreasing, threads );
     }
   }
   return R_NilValue;
@@ -1400,41 +1548,54 @@ SEXP naLast, SEXP decreasing)
   return R_NilValue;
 }
 
+// Check an index vector against the extent rc.  The result is a list of
+// a flag and the cleaned indices: list(NULL, NULL) for indices that are
+// out of range or mix signs, list(FALSE, NULL) if they can be used as
+// they are, and otherwise list(TRUE, cleaned).  Negative indices are
+// cleaned into an "index.runs" matrix of the 1-based starts and lengths
+// of the runs they leave, so x[-bad, ] never holds a vector of every row.
+// indices is read a chunk at a time, so 1:n is never expanded.
 // [[Rcpp::export]]
 SEXP CCleanIndices(SEXP indices, SEXP rc)
 {
   typedef std::vector<index_type> Indices;
 
-  double *pIndices = REAL(indices);
-  index_type numIndices = Rf_length(indices);
+  index_type numIndices = Rf_xlength(indices);
   double maxrc = REAL(rc)[0];
   int protectCount=1;
   SEXP ret = Rf_protect(Rf_allocVector(VECSXP, 2));
   index_type negIndexCount=0;
   index_type posIndexCount=0;
   index_type zeroIndexCount=0;
-  Indices::size_type i,j;
+  double buffer[INDEX_CHUNK];
+  const double *pIndices;
+  index_type i, j, n;
   // See if the indices are within range, negative, positive, zero, or mixed.
-  for (i=0; i < static_cast<Indices::size_type>(numIndices); ++i)
+  for (i=0; i < numIndices; i += n)
   {
-    if (static_cast<index_type>(pIndices[i]) == 0)
-    {
-      ++zeroIndexCount;
-    }
-    if (static_cast<index_type>(pIndices[i]) < 0)
-    {
-      ++negIndexCount;
-    }
-    if (static_cast<index_type>(pIndices[i]) > 0)
-    {
-      ++posIndexCount;
-    }
-    if ( labs(static_cast<index_type>(pIndices[i])) > maxrc )
+    n = std::min(INDEX_CHUNK, numIndices - i);
+    pIndices = IndexChunk(indices, i, n, buffer);
+    for (j=0; j < n; ++j)
     {
-      SET_VECTOR_ELT(ret, 0, R_NilValue);
-      SET_VECTOR_ELT(ret, 1, R_NilValue);
-      Rf_unprotect(protectCount);
-      return ret;
+      if (static_cast<index_type>(pIndices[j]) == 0)
+      {
+        ++zeroIndexCount;
+      }
+      if (static_cast<index_type>(pIndices[j]) < 0)
+      {
+        ++negIndexCount;
+      }
+      if (static_cast<index_type>(pIndices[j]) > 0)
+      {
+        ++posIndexCount;
+      }
+      if ( labs(static_cast<index_type>(pIndices[j])) > maxrc )
+      {
+        SET_VECTOR_ELT(ret, 0, R_NilValue);
+        SET_VECTOR_ELT(ret, 1, R_NilValue);
+        Rf_unprotect(protectCount);
+        return ret;
+      }
     }
   }
   
@@ -1464,12 +1625,17 @@ SEXP CCleanIndices(SEXP indices, SEXP rc)
     LOGICAL(returnCond)[0] = (Rboolean)1;
     SEXP newIndices = Rf_protect(Rf_allocVector(REALSXP,posIndexCount));
     double *newPIndices = REAL(newIndices);
-    j=0;
-    for (i=0; i < static_cast<Indices::size_type>(numIndices); ++i)
+    index_type k=0;
+    for (i=0; i < numIndices; i += n)
     {
-      if (static_cast<index_type>(pIndices[i]) != 0)
+      n = std::min(INDEX_CHUNK, numIndices - i);
+      pIndices = IndexChunk(indices, i, n, buffer);
+      for (j=0; j < n; ++j)
       {
-        newPIndices[j++] = pIndices[i]; 
+        if (static_cast<index_type>(pIndices[j]) != 0)
+        {
+          newPIndices[k++] = pIndices[j]; 
+        }
       }
     }
     SET_VECTOR_ELT(ret, 0, returnCond);
@@ -1479,52 +1645,47 @@ SEXP CCleanIndices(SEXP indices, SEXP rc)
   }
   else if (negIndexCount > 0)
   {
-    // It might be better to use a data-structure other than a vector
-    // (sequential ordering).
-    Indices ind;
-    try
-    {
-      ind.reserve(static_cast<index_type>(maxrc));
-    }
-    catch(...)
-    {
-      SET_VECTOR_ELT(ret, 0, R_NilValue);
-      SET_VECTOR_ELT(ret, 1, R_NilValue);
-      Rf_unprotect(protectCount);
-      return ret;
-    }
-    for (i=1; i <= static_cast<Indices::size_type>(maxrc); ++i)
-    {
-      ind.push_back(i);
-    }
-    Indices::iterator it;
-    for (i=0; i < static_cast<Indices::size_type>(numIndices); ++i)
+    // Sort the excluded indices; the runs between them are what is kept,
+    // found in O(k log k) whatever maxrc is.
+    Indices excluded;
+    excluded.reserve(numIndices);
+    for (i=0; i < numIndices; i += n)
     {
-      it = std::lower_bound(ind.begin(), ind.end(), 
-        static_cast<index_type>(-1*pIndices[i]));
-      if ( it != ind.end() && *it == -1*static_cast<index_type>(pIndices[i]) )
+      n = std::min(INDEX_CHUNK, numIndices - i);
+      pIndices = IndexChunk(indices, i, n, buffer);
+      for (j=0; j < n; ++j)
       {
-        ind.erase(it);
+        excluded.push_back(-1*static_cast<index_type>(pIndices[j]));
       }
     }
-/*
-    if (TooManyRIndices(ind.size()))
-    {
-      SET_VECTOR_ELT(ret, 0, R_NilValue);
-      SET_VECTOR_ELT(ret, 1, R_NilValue);
-      Rf_unprotect(protectCount);
-      return ret;
-    }
-*/
-    protectCount +=2;
+    std::sort(excluded.begin(), excluded.end());
+    excluded.erase(std::unique(excluded.begin(), excluded.end()),
+      excluded.end());
+    std::vector<IndexRun> kept;
+    IndexRun run;
+    run.first = 0;
+    Indices::const_iterator it;
+    for (it = excluded.begin(); it != excluded.end(); ++it)
+    {
+      run.length = *it - 1 - run.first;
+      if (run.length > 0) kept.push_back(run);
+      run.first = *it;
+    }
+    run.length = static_cast<index_type>(maxrc) - run.first;
+    if (run.length > 0) kept.push_back(run);
+    protectCount +=3;
     SEXP returnCond = Rf_protect(Rf_allocVector(LGLSXP,1));
     LOGICAL(returnCond)[0] = (Rboolean)1;
-    SEXP newIndices = Rf_protect(Rf_allocVector(REALSXP,ind.size()));
+    SEXP newIndices = Rf_protect(Rf_allocMatrix(REALSXP,
+      static_cast<int>(kept.size()), 2));
     double *newPIndices = REAL(newIndices);
-    for (i=0; i < ind.size(); ++i)
+    for (i=0; i < static_cast<index_type>(kept.size()); ++i)
     {
-      newPIndices[i] = static_cast<double>(ind[i]);
+      newPIndices[i] = static_cast<double>(kept[i].first + 1);
+      newPIndices[kept.size()+i] = static_cast<double>(kept[i].length);
     }
+    Rf_setAttrib(newIndices, R_ClassSymbol,
+      Rf_protect(Rf_mkString("index.runs")));
     SET_VECTOR_ELT(ret, 0, returnCond);
     SET_VECTOR_ELT(ret, 1, newIndices);
     Rf_unprotect(protectCount);
@@ -1595,6 +1756,17 @@ SEXP GetRowNamesBM(SEXP address)
   return Rcpp::wrap(rn);
 }
 
+// The header embedded in a backing file records the dimnames, so it is
+// rewritten whenever they change.
+static void UpdateEmbeddedHeader( BigMatrix *pMat )
+{
+  FileBackedBigMatrix *pfbm = dynamic_cast<FileBackedBigMatrix*>(pMat);
+  if (pfbm && pfbm->embedded_header() && !pfbm->write_header())
+  {
+    Rf_error("Problem writing the header of the filebacked matrix.");
+  }
+}
+
 // [[Rcpp::export]]
 void SetColumnNames(SEXP address, SEXP columnNames)
 {
@@ -1604,6 +1776,7 @@ void SetColumnNames(SEXP address, SEXP columnNames)
   for (i=0; i < Rf_length(columnNames); ++i)
     cn.push_back(string(CHAR(STRING_ELT(columnNames, i))));
   pMat->column_names(cn);
+  UpdateEmbeddedHeader(pMat);
 }
 
 // [[Rcpp::export]]
@@ -1615,6 +1788,7 @@ void SetRowNames(SEXP address, SEXP rowNames)
   for (i=0; i < Rf_length(rowNames); ++i)
     rn.push_back(string(CHAR(STRING_ELT(rowNames, i))));
   pMat->row_names(rn);
+  UpdateEmbeddedHeader(pMat);
 }
 
 // [[Rcpp::export]]
@@ -1724,122 +1898,142 @@ void CDestroyBigMatrix(SEXP bigMatrixAddr)
   R_ClearExternalPtr(bigMatrixAddr);
 }
 
-// only called in C code
-inline bool Lcomp(double a, double b, int op) {
-  return(op==0 ? a<=b : a<b);
-}
-inline bool Gcomp(double a, double b, int op) {
-  return(op==0 ? a>=b : a>b);
-}
-
-
+// zones, when given, is the zone map of the matrix mat is a view of, and
+// column j of mat is column j+colOffset of that matrix.
 template<typename T, typename MatrixType>
 SEXP MWhichMatrix( MatrixType mat, index_type nrow, SEXP selectColumn, 
-  SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal, double C_NA )
+  SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal, double C_NA,
+  SEXP threads, ZoneMap *zones=NULL, index_type colOffset=0 )
 {
+  int numThreads = std::max(Rf_asInteger(threads), 1);
   index_type numSc = Rf_length(selectColumn);
   double *sc = REAL(selectColumn);
   double *min = REAL(minVal);
   double *max = REAL(maxVal);
   int *chkmin = INTEGER(chkMin);
   int *chkmax = INTEGER(chkMax);
-
-  double minV, maxV;
-  int ov = Rf_asInteger(opVal);
-  index_type count = 0;
-  index_type i,j;
-  double val;
-  for (i=0; i < nrow; ++i) {
-    for (j=0; j < numSc; ++j)  {
-      minV = min[j];
-      maxV = max[j];
-      if (isna(minV)) {
-        minV = static_cast<T>(C_NA);
-        maxV = static_cast<T>(C_NA);
-      }
-      val = (double) mat[(index_type)sc[j]-1][i];
-      if (chkmin[j]==-1) { // this is an 'neq'
-        if (ov==1) { 
-          // OR with 'neq'
-          if  ( (minV!=val) ||
-                ( (isna(val) && !isna(minV)) ||
-                  (!isna(val) && isna(minV)) ) ) {
-            ++count;
-            break;
-          }
-        } else {
-          // AND with 'neq'   // if they are equal, then break out.
-          if ( (minV==val) || (isna(val) && isna(minV)) ) break;
-        }
-      } else { // not a 'neq'     
-
-        // If it's an OR operation and it's true for one, it's true for the
-        // whole row.
-        if ( ( (Gcomp(val, minV, chkmin[j]) && Lcomp(val, maxV, chkmax[j])) ||
-               (isna(val) && isna(minV))) && ov==1 ) { 
-          ++count;
-          break;
+  bool orOp = Rf_asInteger(opVal) == 1;
+
+  std::vector<index_type> cols(numSc);
+  std::vector< MWhichPredicate<T> > preds(numSc);
+  index_type j;
+  for (j=0; j < numSc; ++j)
+  {
+    cols[j] = static_cast<index_type>(sc[j]) - 1;
+    preds[j] = MakeMWhichPredicate<T>(min[j], max[j], chkmin[j], chkmax[j],
+      orOp, C_NA);
+  }
+
+  // Blocks are independent, so they are shared out among the threads;
+  // each block's hits then go at an offset given by the counts of the
+  // blocks before it, which keeps the result in row order.
+  const index_type numBlocks = (nrow + MWHICH_BLOCK_ROWS - 1) / 
+    MWHICH_BLOCK_ROWS;
+  std::vector<uint64_t> sel((nrow + 63) / 64);
+  std::vector<index_type> blockStarts(numBlocks+1, 0);
+  index_type b;
+
+  // Bring the zones of the columns involved up to date.  A column written
+  // to since it was last summarized is summarized again in full; this
+  // costs about as much as the scan it will save next time.
+  std::vector<ZoneBlock*> zoneCols(numSc, static_cast<ZoneBlock*>(NULL));
+  if (zones)
+  {
+    for (j=0; j < numSc; ++j)
+    {
+      index_type col = cols[j] + colOffset;
+      ZoneBlock *pZones = zones->blocks(col);
+      if (!zones->current(col))
+      {
+        uint64_t gen = zones->generation(col);
+        const T *pColumn = mat[cols[j]];
+#ifdef _OPENMP
+        #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+#endif
+        for (b=0; b < numBlocks; ++b)
+        {
+          index_type first = b*MWHICH_BLOCK_ROWS;
+          SummarizeZone(pColumn + first, 
+            std::min(MWHICH_BLOCK_ROWS, nrow - first), pZones[b]);
         }
-        // If it's an AND operation and it's false for one, it's false for
-        // the whole row.
-        if ( ( (Lcomp(val, minV, 1-chkmin[j]) || Gcomp(val, maxV, 1-chkmax[j])) 
-             ||
-               (isna(val) && !isna(minV)) || (!isna(val) && isna(minV)) ) &&
-             ov == 0 ) break;
+        zones->mark_current(col, gen);
       }
+      zoneCols[j] = pZones;
     }
-    // If it's an AND operation and it's true for each column, it's true
-    // for the entire row.
-    if (j==numSc && ov == 0) ++count;
   }
 
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+#endif
+  for (b=0; b < numBlocks; ++b)
+  {
+    index_type first = b*MWHICH_BLOCK_ROWS;
+    index_type n = std::min(MWHICH_BLOCK_ROWS, nrow - first);
+    if (zones)
+    {
+      // Predicates the zones settle no longer read the block.
+      std::vector< MWhichPredicate<T> > blockPreds(preds);
+      index_type k;
+      for (k=0; k < numSc; ++k)
+      {
+        blockPreds[k].kind = ZoneStatus(preds[k], zoneCols[k][b], n);
+      }
+      MWhichBlock<T>(mat, cols, blockPreds, orOp, first, n, &sel[first/64]);
+    }
+    else
+    {
+      MWhichBlock<T>(mat, cols, preds, orOp, first, n, &sel[first/64]);
+    }
+    blockStarts[b+1] = MWhichCount(&sel[first/64], n);
+  }
+  for (b=0; b < numBlocks; ++b)
+  {
+    blockStarts[b+1] += blockStarts[b];
+  }
+  index_type count = blockStarts[numBlocks];
   if (count==0) return Rf_allocVector(INTSXP,0);
 
   SEXP ret = Rf_protect(Rf_allocVector(REALSXP,count));
   double *retVals = REAL(ret);
-  index_type k = 0;
-  for (i=0; i < nrow; ++i) {
-    for (j=0; j < numSc; ++j) {
-      minV = min[j];
-      maxV = max[j];
-      if (isna(minV)) {
-        minV = static_cast<T>(C_NA);
-        maxV = static_cast<T>(C_NA);
-      }
-      val = (double) mat[(index_type)sc[j]-1][i];
-
-      if (chkmin[j]==-1) { // this is an 'neq'
-        if (ov==1) {
-          // OR with 'neq'
-          if  ( (minV!=val) ||
-                ( (isna(val) && !isna(minV)) || 
-                  (!isna(val) && isna(minV)) ) ) {
-            retVals[k++] = i+1;
-            break;
-          }
-        } else {
-          // AND with 'neq'   // if they are equal, then break out.
-          if ( (minV==val) || (isna(val) && isna(minV)) ) break;
-        }
-      } else { // not a 'neq'
-
-        if ( ( (Gcomp(val, minV, chkmin[j]) && Lcomp(val, maxV, chkmax[j])) ||
-               (isna(val) && isna(minV))) && ov==1 ) {
-          retVals[k++] = i+1;
-          break;
-        }
-        if (((Lcomp(val, minV, 1-chkmin[j]) || Gcomp(val, maxV, 1-chkmax[j])) ||
-               (isna(val) && !isna(minV)) || (!isna(val) && isna(minV)) ) &&
-             ov == 0 ) break;
-
-      }
-    } // end j loop
-    if (j==numSc && ov == 0) retVals[k++] = i+1;
-  } // end i loop
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+#endif
+  for (b=0; b < numBlocks; ++b)
+  {
+    index_type first = b*MWHICH_BLOCK_ROWS;
+    MWhichRowNumbers(&sel[first/64], std::min(MWHICH_BLOCK_ROWS, 
+      nrow - first), first, retVals + blockStarts[b]);
+  }
   Rf_unprotect(1);
   return(ret);
 }
 
+// Look up a range of keys in an index built by big.index(): column 0 of
+// mat holds the keys in increasing order and column 1 the row each came
+// from.  The matching rows are returned in increasing order, as mwhich
+// returns them.
+template<typename MatrixType>
+SEXP IndexRange( MatrixType mat, index_type nrow, double minV, double maxV,
+  bool strictMin, bool strictMax )
+{
+  const double *keys = mat[0];
+  const double *rows = mat[1];
+  const double *first = strictMin ? 
+    std::upper_bound(keys, keys+nrow, minV) :
+    std::lower_bound(keys, keys+nrow, minV);
+  const double *last = strictMax ?
+    std::lower_bound(first, keys+nrow, maxV) :
+    std::upper_bound(first, keys+nrow, maxV);
+  index_type count = last - first;
+  if (count == 0) return Rf_allocVector(INTSXP, 0);
+  SEXP ret = Rf_protect(Rf_allocVector(REALSXP, count));
+  double *pRet = REAL(ret);
+  std::copy(rows + (first - keys), rows + (last - keys), pRet);
+  std::sort(pRet, pRet + count);
+  Rf_unprotect(1);
+  return ret;
+}
+
 template<typename T>
 SEXP CreateRAMMatrix(SEXP row, SEXP col, SEXP colnames, SEXP rownames,
   SEXP typeLength, SEXP ini, SEXP separated)
@@ -2047,9 +2241,21 @@ SEXP GetMatrixSize( SEXP bigMat )
 
 // [[Rcpp::export]]
 SEXP MWhichBigMatrix( SEXP bigMatAddr, SEXP selectColumn, SEXP minVal,
-                     SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal )
+                     SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal,
+                     SEXP threads )
 {
     Rcpp::XPtr<BigMatrix> pMat(bigMatAddr);
+    // The zones cover whole columns, so a view of only some of the rows
+    // can't use them.
+    FileBackedBigMatrix *pfbm = dynamic_cast<FileBackedBigMatrix*>(
+      static_cast<BigMatrix*>(pMat));
+    ZoneMap *zones = NULL;
+    if (pfbm && pfbm->zone_map() && pMat->row_offset() == 0 &&
+      pMat->nrow() == pMat->total_rows() &&
+      pfbm->zone_map()->block_rows() == MWHICH_BLOCK_ROWS)
+    {
+      zones = pfbm->zone_map();
+    }
   
     if (pMat->separated_columns())
     {
@@ -2058,23 +2264,28 @@ SEXP MWhichBigMatrix( SEXP bigMatAddr, SEXP selectColumn, SEXP minVal,
           case 1:
             return MWhichMatrix<char>( SepMatrixAccessor<char>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_CHAR);
+              opVal, NA_CHAR, threads, zones, 
+              pMat->col_offset());
           case 2:
             return MWhichMatrix<short>( SepMatrixAccessor<short>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_SHORT);
+              opVal, NA_SHORT, threads, zones, 
+              pMat->col_offset());
           case 4:
             return MWhichMatrix<int>( SepMatrixAccessor<int>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_INTEGER);
+              opVal, NA_INTEGER, threads, zones, 
+              pMat->col_offset());
           case 6:
             return MWhichMatrix<float>( SepMatrixAccessor<float>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_FLOAT);
+              opVal, NA_FLOAT, threads, zones, 
+              pMat->col_offset());
           case 8:
             return MWhichMatrix<double>( SepMatrixAccessor<double>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_REAL);
+              opVal, NA_REAL, threads, zones, 
+              pMat->col_offset());
         }
     }
     else
@@ -2084,72 +2295,111 @@ SEXP MWhichBigMatrix( SEXP bigMatAddr, SEXP selectColumn, SEXP minVal,
           case 1:
             return MWhichMatrix<char>( MatrixAccessor<char>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_CHAR);
+              opVal, NA_CHAR, threads, zones, 
+              pMat->col_offset());
           case 2:
             return MWhichMatrix<short>( MatrixAccessor<short>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_SHORT);
+              opVal, NA_SHORT, threads, zones, 
+              pMat->col_offset());
           case 4:
             return MWhichMatrix<int>( MatrixAccessor<int>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_INTEGER);
+              opVal, NA_INTEGER, threads, zones, 
+              pMat->col_offset());
           case 6:
             return MWhichMatrix<float>( MatrixAccessor<float>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_FLOAT);
+              opVal, NA_FLOAT, threads, zones, 
+              pMat->col_offset());
           case 8:
             return MWhichMatrix<double>( MatrixAccessor<double>(*pMat),
               pMat->nrow(), selectColumn, minVal, maxVal, chkMin, chkMax, 
-              opVal, NA_REAL);
+              opVal, NA_REAL, threads, zones, 
+              pMat->col_offset());
         }
     }
     return R_NilValue;
 }
 
+// [[Rcpp::export]]
+SEXP CIndexRange( SEXP indexAddr, SEXP minVal, SEXP maxVal, SEXP chkMin,
+  SEXP chkMax )
+{
+  Rcpp::XPtr<BigMatrix> pMat(indexAddr);
+  double minV = Rf_asReal(minVal);
+  double maxV = Rf_asReal(maxVal);
+  bool strictMin = Rf_asInteger(chkMin) == 1;
+  bool strictMax = Rf_asInteger(chkMax) == 1;
+  if (pMat->separated_columns())
+  {
+    return IndexRange(SepMatrixAccessor<double>(*pMat), pMat->nrow(),
+      minV, maxV, strictMin, strictMax);
+  }
+  return IndexRange(MatrixAccessor<double>(*pMat), pMat->nrow(),
+    minV, maxV, strictMin, strictMax);
+}
+
 // [[Rcpp::export]]
 SEXP MWhichRIntMatrix( SEXP matrixVector, SEXP nrow, SEXP selectColumn,
-  SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal )
+  SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal, 
+  SEXP threads )
 {
   index_type numRows = static_cast<index_type>(Rf_asInteger(nrow));
   MatrixAccessor<int> mat(INTEGER(matrixVector), numRows);
   return MWhichMatrix<int, MatrixAccessor<int> >(mat, numRows, 
-    selectColumn, minVal, maxVal, chkMin, chkMax, opVal, NA_INTEGER);
+    selectColumn, minVal, maxVal, chkMin, chkMax, opVal, NA_INTEGER, threads);
 }
 
 // [[Rcpp::export]]
 SEXP MWhichRNumericMatrix( SEXP matrixVector, SEXP nrow, SEXP selectColumn,
-  SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal )
+  SEXP minVal, SEXP maxVal, SEXP chkMin, SEXP chkMax, SEXP opVal, 
+  SEXP threads )
 {
   index_type numRows = static_cast<index_type>(Rf_asInteger(nrow));
   MatrixAccessor<double> mat(REAL(matrixVector), numRows);
   return MWhichMatrix<double, MatrixAccessor<double> >(mat, numRows,
-    selectColumn, minVal, maxVal, chkMin, chkMax, opVal, NA_REAL);
+    selectColumn, minVal, maxVal, chkMin, chkMax, opVal, NA_REAL, threads);
 }
 
+// Count the lines in a file.  The result is a list with the number of
+// newlines, the byte offsets of the newline-aligned chunks the file was
+// scanned in, and the number of newlines in each chunk; ReadMatrix can
+// reuse the chunks instead of scanning the file again.
 // [[Rcpp::export]]
-SEXP CCountLines(SEXP fileName)
-{ 
-  FILE *FP;
-  double lineCount = 0;
-  char readChar;
-  FP = fopen(CHAR(Rf_asChar(fileName)), "r");
-  SEXP ret = Rf_protect(Rf_allocVector(REALSXP,1));
-  REAL(ret)[0] = -1;                   
-  if (FP == NULL) return(ret);
-  do {
-    readChar = fgetc(FP);
-    if ('\n' == readChar) ++lineCount;
-  } while( readChar != EOF );
-  fclose(FP);
-  REAL(ret)[0] = lineCount; 
-  Rf_unprotect(1);                  
-  return(ret);
+SEXP CCountLines(SEXP fileName, SEXP threads)
+{
+  int numThreads = std::max(Rf_asInteger(threads), 1);
+  MappedTextFile file;
+  std::vector<const char*> bounds;
+  std::vector<index_type> newlines;
+  double lineCount = -1;
+  if (file.open(CHAR(Rf_asChar(fileName))))
+  {
+    lineCount = static_cast<double>(ScanLines(file.begin(), file.end(),
+      NumTextChunks(file.size(), numThreads), numThreads, bounds, newlines));
+  }
+  index_type numChunks = static_cast<index_type>(newlines.size());
+  index_type i;
+  Rcpp::NumericVector offsets(bounds.size());
+  Rcpp::NumericVector chunkLines(numChunks);
+  for (i=0; i < static_cast<index_type>(bounds.size()); ++i)
+  {
+    offsets[i] = static_cast<double>(bounds[i] - file.begin());
+  }
+  for (i=0; i < numChunks; ++i)
+  {
+    chunkLines[i] = static_cast<double>(newlines[i]);
+  }
+  return Rcpp::List::create(Rcpp::Named("lines") = lineCount,
+    Rcpp::Named("offsets") = offsets, Rcpp::Named("newlines") = chunkLines);
 }
 
 // [[Rcpp::export]]
 SEXP ReadMatrix(SEXP fileName, SEXP bigMatAddr,
                 SEXP firstLine, SEXP numLines, SEXP numCols, SEXP separator,
-                SEXP hasRowNames, SEXP useRowNames)
+                SEXP hasRowNames, SEXP useRowNames, SEXP threads, 
+                SEXP chunks)
 {
     Rcpp::XPtr<BigMatrix> pMat(bigMatAddr);
     if (pMat->separated_columns())
@@ -2159,28 +2409,28 @@ SEXP ReadMatrix(SEXP fileName, SEXP bigMatAddr,
           case 1:
             return ReadMatrix<char, SepMatrixAccessor<char> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_CHAR, NA_CHAR, NA_CHAR, 
+              separator, hasRowNames, useRowNames, threads, chunks, NA_CHAR, NA_CHAR, 
               NA_CHAR);
           case 2:
             return ReadMatrix<short, SepMatrixAccessor<short> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_SHORT, NA_SHORT, NA_SHORT, 
+              separator, hasRowNames, useRowNames, threads, chunks, NA_SHORT, NA_SHORT, 
               NA_SHORT);
           case 4:
             return ReadMatrix<int, SepMatrixAccessor<int> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_INTEGER, NA_INTEGER, 
+              separator, hasRowNames, useRowNames, threads, chunks, NA_INTEGER, 
               NA_INTEGER, NA_INTEGER);
           case 6:
             return ReadMatrix<float, SepMatrixAccessor<float> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_FLOAT, NA_FLOAT, 
+              separator, hasRowNames, useRowNames, threads, chunks, NA_FLOAT, 
               NA_FLOAT, NA_FLOAT);
           case 8:
             return ReadMatrix<double, SepMatrixAccessor<double> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_REAL, R_PosInf, R_NegInf, 
-              R_NaN);
+              separator, hasRowNames, useRowNames, threads, chunks, NA_REAL, R_PosInf, 
+              R_NegInf);
         }
     }
     else
@@ -2190,28 +2440,28 @@ SEXP ReadMatrix(SEXP fileName, SEXP bigMatAddr,
           case 1:
             return ReadMatrix<char, MatrixAccessor<char> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_CHAR, NA_CHAR, NA_CHAR, 
+              separator, hasRowNames, useRowNames, threads, chunks, NA_CHAR, NA_CHAR, 
               NA_CHAR);
           case 2:
             return ReadMatrix<short, MatrixAccessor<short> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_SHORT, NA_SHORT, NA_SHORT, 
+              separator, hasRowNames, useRowNames, threads, chunks, NA_SHORT, NA_SHORT, 
               NA_SHORT);
           case 4:
             return ReadMatrix<int, MatrixAccessor<int> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_INTEGER, NA_INTEGER, 
+              separator, hasRowNames, useRowNames, threads, chunks, NA_INTEGER, 
               NA_INTEGER, NA_INTEGER);
           case 6:
             return ReadMatrix<float, MatrixAccessor<float> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_FLOAT, NA_FLOAT, 
+              separator, hasRowNames, useRowNames, threads, chunks, NA_FLOAT, 
               NA_FLOAT, NA_FLOAT);
           case 8:
             return ReadMatrix<double, MatrixAccessor<double> >(
               fileName, pMat, firstLine, numLines, numCols, 
-              separator, hasRowNames, useRowNames, NA_REAL, R_PosInf, R_NegInf, 
-              R_NaN);
+              separator, hasRowNames, useRowNames, threads, chunks, NA_REAL, R_PosInf, 
+              R_NegInf);
         }
     }
     return R_NilValue;
@@ -2219,7 +2469,7 @@ SEXP ReadMatrix(SEXP fileName, SEXP bigMatAddr,
 
 // [[Rcpp::export]]
 void WriteMatrix( SEXP bigMatAddr, SEXP fileName, SEXP rowNames,
-  SEXP colNames, SEXP sep )
+  SEXP colNames, SEXP sep, SEXP threads )
 {
     Rcpp::XPtr<BigMatrix> pMat(bigMatAddr);
     if (pMat->separated_columns())
@@ -2228,23 +2478,23 @@ void WriteMatrix( SEXP bigMatAddr, SEXP fileName, SEXP rowNames,
         {
           case 1:
             WriteMatrix<char, SepMatrixAccessor<char> >(
-              pMat, fileName, rowNames, colNames, sep, NA_CHAR);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_CHAR);
             break;
           case 2:
             WriteMatrix<short, SepMatrixAccessor<short> >(
-              pMat, fileName, rowNames, colNames, sep, NA_SHORT);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_SHORT);
             break;
           case 4:
             WriteMatrix<int, SepMatrixAccessor<int> >(
-              pMat, fileName, rowNames, colNames, sep, NA_INTEGER);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_INTEGER);
             break;
           case 6:
             WriteMatrix<float, SepMatrixAccessor<float> >(
-              pMat, fileName, rowNames, colNames, sep, NA_FLOAT);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_FLOAT);
             break;
           case 8:
             WriteMatrix<double, SepMatrixAccessor<double> >(
-              pMat, fileName, rowNames, colNames, sep, NA_REAL);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_REAL);
         }
     }
     else
@@ -2253,23 +2503,23 @@ void WriteMatrix( SEXP bigMatAddr, SEXP fileName, SEXP rowNames,
         {
           case 1:
             WriteMatrix<char, MatrixAccessor<char> >(
-              pMat, fileName, rowNames, colNames, sep, NA_CHAR);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_CHAR);
             break;
           case 2:
             WriteMatrix<short, MatrixAccessor<short> >(
-              pMat, fileName, rowNames, colNames, sep, NA_SHORT);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_SHORT);
             break;
           case 4:
             WriteMatrix<int, MatrixAccessor<int> >(
-              pMat, fileName, rowNames, colNames, sep, NA_INTEGER);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_INTEGER);
             break;
           case 6:
             WriteMatrix<float, MatrixAccessor<float> >(
-              pMat, fileName, rowNames, colNames, sep, NA_FLOAT);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_FLOAT);
             break;
           case 8:
             WriteMatrix<double, MatrixAccessor<double> >(
-              pMat, fileName, rowNames, colNames, sep, NA_REAL);
+              pMat, fileName, rowNames, colNames, sep, threads, NA_REAL);
         }
     }
 }
@@ -2529,6 +2779,7 @@ void SetMatrixElements(SEXP bigMatAddr, SEXP col, SEXP row, SEXP values)
           pMat, col, row, values, NA_REAL, R_DOUBLE_MIN, R_DOUBLE_MAX, NA_REAL);
     }
   }
+  TouchZoneMap(pMat, col);
 }
 
 // Function contributed by Peter Haverty at Genentech.
@@ -2586,6 +2837,7 @@ void SetIndivMatrixElements(SEXP bigMatAddr, SEXP col, SEXP row, SEXP values)
         pMat, col, row, values, NA_REAL, R_DOUBLE_MIN, R_DOUBLE_MAX, NA_REAL);
     }
   }
+  TouchZoneMap(pMat, col);
 }
 
 // [[Rcpp::export]]
@@ -2644,6 +2896,7 @@ void SetMatrixAll(SEXP bigMatAddr, SEXP values)
           pMat, values, NA_REAL, R_DOUBLE_MIN, R_DOUBLE_MAX, NA_REAL);
     }
   }
+  TouchZoneMap(pMat, R_NilValue);
 }
 
 // [[Rcpp::export]]
@@ -2702,6 +2955,7 @@ void SetMatrixCols(SEXP bigMatAddr, SEXP col, SEXP values)
           pMat, col, values, NA_REAL, R_DOUBLE_MIN, R_DOUBLE_MAX, NA_REAL);
     }
   }
+  TouchZoneMap(pMat, col);
 }
 
 // [[Rcpp::export]]
@@ -2760,6 +3014,7 @@ void SetMatrixRows(SEXP bigMatAddr, SEXP row, SEXP values)
           pMat, row, values, NA_REAL, R_DOUBLE_MIN, R_DOUBLE_MAX, NA_REAL);
     }
   }
+  TouchZoneMap(pMat, R_NilValue);
 }
 
 // [[Rcpp::export]]
@@ -2781,7 +3036,7 @@ SEXP CreateLocalMatrix(SEXP row, SEXP col, SEXP colnames, SEXP rownames,
 // [[Rcpp::export]]
 SEXP CreateFileBackedBigMatrix(SEXP fileName, SEXP filePath, SEXP row, 
   SEXP col, SEXP colnames, SEXP rownames, SEXP typeLength, SEXP ini, 
-  SEXP separated)
+  SEXP separated, SEXP embed)
 {
   try
   {
@@ -2802,7 +3057,8 @@ SEXP CreateFileBackedBigMatrix(SEXP fileName, SEXP filePath, SEXP row,
       static_cast<index_type>(REAL(row)[0]),
       static_cast<index_type>(REAL(col)[0]),
       Rf_asInteger(typeLength),
-      static_cast<bool>(LOGICAL(separated)[0])))
+      static_cast<bool>(LOGICAL(separated)[0]),
+      static_cast<bool>(LOGICAL(embed)[0])))
     {
       delete pMat;
       Rf_error("Problem creating filebacked matrix.");
@@ -2816,6 +3072,14 @@ SEXP CreateFileBackedBigMatrix(SEXP fileName, SEXP filePath, SEXP row,
     {
       pMat->row_names(RChar2StringVec(rownames));
     }
+    if (pMat->embedded_header() && 
+      (colnames != R_NilValue || rownames != R_NilValue) &&
+      !pMat->write_header())
+    {
+      delete pMat;
+      Rf_error("Problem writing the header of the filebacked matrix.");
+      return R_NilValue;
+    }
     if (Rf_length(ini) != 0)
     {
       if (pMat->separated_columns())
@@ -2953,6 +3217,23 @@ SEXP CAttachFileBackedBigMatrix(SEXP fileName,
   return address;
 }
 
+// [[Rcpp::export]]
+SEXP CAttachEmbeddedBigMatrix(SEXP fileName, SEXP filePath, SEXP readOnly)
+{
+  FileBackedBigMatrix *pMat = new FileBackedBigMatrix();
+  if (!pMat->attach(RChar2String(fileName), RChar2String(filePath),
+    static_cast<bool>(LOGICAL(readOnly)[0])))
+  {
+    delete pMat;
+    return R_NilValue;
+  }
+  SEXP address = R_MakeExternalPtr( dynamic_cast<BigMatrix*>(pMat),
+    R_NilValue, R_NilValue);
+  R_RegisterCFinalizerEx(address, (R_CFinalizer_t) CDestroyBigMatrix, 
+      (Rboolean) TRUE);
+  return address;
+}
+
 // [[Rcpp::export]]
 SEXP SharedName( SEXP address )
 {
@@ -2975,7 +3256,7 @@ SEXP FileName( SEXP address )
 }
 
 // [[Rcpp::export]]
-SEXP Flush( SEXP address )  
+SEXP Flush( SEXP address, SEXP async )  
 {   
   FileBackedBigMatrix *pMat =   
     reinterpret_cast<FileBackedBigMatrix*>(R_ExternalPtrAddr(address));   
@@ -2983,7 +3264,8 @@ SEXP Flush( SEXP address )
   SEXP ret = Rf_protect(Rf_allocVector(LGLSXP,1));
   if (pfbbm)
   { 
-    LOGICAL(ret)[0] = pfbbm->flush() ? (Rboolean)TRUE : Rboolean(FALSE);
+    LOGICAL(ret)[0] = pfbbm->flush(LOGICAL(async)[0] != 0) ? 
+      (Rboolean)TRUE : Rboolean(FALSE);
   }
   else
   {
@@ -3005,6 +3287,74 @@ SEXP IsShared( SEXP address )
   return ret;
 }
 
+// [[Rcpp::export]]
+SEXP SetMapPolicy( SEXP address, SEXP hugepages, SEXP prefault )
+{
+  BigMatrix *pMat = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(address));
+  int policy = BigMatrix::POLICY_DEFAULT;
+  if (LOGICAL(hugepages)[0]) policy |= BigMatrix::POLICY_HUGEPAGES;
+  if (LOGICAL(prefault)[0]) policy |= BigMatrix::POLICY_PREFAULT;
+  return Rf_ScalarLogical(pMat->map_policy(policy) ? 1 : 0);
+}
+
+// [[Rcpp::export]]
+SEXP GetMapPolicy( SEXP address )
+{
+  BigMatrix *pMat = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(address));
+  SEXP ret = Rf_protect(Rf_allocVector(LGLSXP,2));
+  LOGICAL(ret)[0] = (pMat->map_policy() & BigMatrix::POLICY_HUGEPAGES) != 0;
+  LOGICAL(ret)[1] = (pMat->map_policy() & BigMatrix::POLICY_PREFAULT) != 0;
+  Rf_unprotect(1);
+  return ret;
+}
+
+// [[Rcpp::export]]
+SEXP CAdvise( SEXP address, SEXP pattern, SEXP rows, SEXP cols )
+{
+  BigMatrix *pMat = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(address));
+  SharedBigMatrix *psbm = dynamic_cast<SharedBigMatrix*>(pMat);
+  if (!psbm)
+  {
+    Rf_error("Object is not a shared or filebacked big.matrix.");
+  }
+  bool ok = psbm->advise(Rf_asInteger(pattern), 
+    static_cast<index_type>(REAL(rows)[0]) - 1,
+    static_cast<index_type>(REAL(rows)[1]),
+    static_cast<index_type>(REAL(cols)[0]) - 1,
+    static_cast<index_type>(REAL(cols)[1]));
+  return Rf_ScalarLogical(ok ? 1 : 0);
+}
+
+// [[Rcpp::export]]
+SEXP CSetZoneMap( SEXP address, SEXP enable )
+{
+  BigMatrix *pMat = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(address));
+  FileBackedBigMatrix *pfbm = dynamic_cast<FileBackedBigMatrix*>(pMat);
+  if (!pfbm)
+  {
+    Rf_error("Object is not a filebacked big.matrix");
+  }
+  return Rf_ScalarLogical(pfbm->zone_map(LOGICAL(enable)[0] != 0) ? 1 : 0);
+}
+
+// The zone map id and the generation of column col (1-based), which
+// together change whenever the column may have been written to; NULL if
+// the matrix has no zone map.
+// [[Rcpp::export]]
+SEXP CColumnStamp( SEXP address, SEXP col )
+{
+  BigMatrix *pMat = reinterpret_cast<BigMatrix*>(R_ExternalPtrAddr(address));
+  FileBackedBigMatrix *pfbm = dynamic_cast<FileBackedBigMatrix*>(pMat);
+  if (!pfbm || !pfbm->zone_map()) return R_NilValue;
+  index_type column = pMat->col_offset() + 
+    static_cast<index_type>(Rf_asReal(col)) - 1;
+  SEXP ret = Rf_protect(Rf_allocVector(REALSXP, 2));
+  REAL(ret)[0] = static_cast<double>(pfbm->zone_map()->id());
+  REAL(ret)[1] = static_cast<double>(pfbm->zone_map()->generation(column));
+  Rf_unprotect(1);
+  return ret;
+}
+
 // [[Rcpp::export]]
 SEXP isnil(SEXP address)
 {
@@ -3076,6 +3426,7 @@ void SetAllMatrixElements(SEXP bigMatAddr, SEXP value)
               pMat, value, NA_REAL, R_DOUBLE_MIN, R_DOUBLE_MAX, NA_REAL);
         }
     }
+    TouchZoneMap(pMat, R_NilValue);
 }
 
 // This doesn't appear to be used anywhere?!?!
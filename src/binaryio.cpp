@@ -0,0 +1,342 @@
+// Binary export and import of big.matrix objects.
+//
+// The file is a fixed header, a block of column and row names, an
+// optional table of CRC-32 checksums (one per column), and then the
+// columns themselves, one after another in column-major order starting
+// on a 64KB boundary.  The data section therefore has the same layout as
+// the backing file of a non-separated file-backed matrix, and moving data
+// in or out is a handful of large copies (copy_file_range where the
+// kernel has it) rather than any per-element work.
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <Rcpp.h>
+
+#include <boost/crc.hpp>
+
+#include "bigmemory/BigMatrix.h"
+#include "bigmemory/FileIO.hpp"
+#include "bigmemory/util.h"
+
+using namespace std;
+
+void CDestroyBigMatrix(SEXP bigMatrixAddr);
+
+static const char BINARY_MAGIC[8] = {'B','I','G','M','A','T','R','X'};
+static const uint32_t BINARY_VERSION = 1;
+static const uint32_t BINARY_BYTE_ORDER = 0x01020304;
+static const index_type BINARY_DATA_ALIGNMENT = 65536;
+
+enum BinaryFlags {BINARY_SEPARATED=1, BINARY_CHECKSUMS=2};
+
+struct BinaryMatrixHeader
+{
+  char magic[8];
+  uint32_t byteOrder;
+  uint32_t version;
+  int32_t matrixType;
+  int32_t flags;
+  int64_t numRows;
+  int64_t numCols;
+  int64_t namesOffset;
+  int64_t namesLength;
+  int64_t checksumOffset;
+  int64_t dataOffset;
+};
+
+static index_type ElementSize( const int matrixType )
+{
+  return matrixType == 6 ?
+    static_cast<index_type>(sizeof(float)) :
+    static_cast<index_type>(matrixType);
+}
+
+// The start of column col of the (sub)matrix in memory.
+static char* ColumnData( BigMatrix *pMat, const index_type col )
+{
+  index_type es = ElementSize(pMat->matrix_type());
+  if (pMat->separated_columns())
+  {
+    return reinterpret_cast<char**>(pMat->matrix())[pMat->col_offset()+col] +
+      pMat->row_offset()*es;
+  }
+  return reinterpret_cast<char*>(pMat->matrix()) +
+    ((pMat->col_offset()+col)*pMat->total_rows() + pMat->row_offset())*es;
+}
+
+static void ColumnChecksums( BigMatrix *pMat, index_type colBytes,
+  int numThreads, std::vector<uint32_t> &checksums )
+{
+  index_type numCols = pMat->ncol();
+  checksums.resize(numCols);
+  index_type j;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+#endif
+  for (j=0; j < numCols; ++j)
+  {
+    boost::crc_32_type crc;
+    crc.process_bytes(ColumnData(pMat, j), static_cast<std::size_t>(colBytes));
+    checksums[j] = crc.checksum();
+  }
+}
+
+// [[Rcpp::export]]
+SEXP CExportBigMatrix(SEXP bigMatAddr, SEXP fileName, SEXP checksums,
+  SEXP threads)
+{
+  Rcpp::XPtr<BigMatrix> pMat(bigMatAddr);
+  int numThreads = std::max(Rf_asInteger(threads), 1);
+  const index_type numRows = pMat->nrow();
+  const index_type numCols = pMat->ncol();
+  const index_type colBytes = numRows * ElementSize(pMat->matrix_type());
+
+  std::string names;
+  AppendNamesBlock(names, pMat->column_names());
+  AppendNamesBlock(names, pMat->row_names());
+  std::vector<uint32_t> crcs;
+  if (LOGICAL(checksums)[0])
+  {
+    ColumnChecksums(pMat, colBytes, numThreads, crcs);
+  }
+
+  BinaryMatrixHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+  header.byteOrder = BINARY_BYTE_ORDER;
+  header.version = BINARY_VERSION;
+  header.matrixType = pMat->matrix_type();
+  header.flags = (pMat->separated_columns() ? BINARY_SEPARATED : 0) |
+    (crcs.empty() ? 0 : BINARY_CHECKSUMS);
+  header.numRows = numRows;
+  header.numCols = numCols;
+  header.namesOffset = sizeof(header);
+  header.namesLength = names.size();
+  header.checksumOffset = crcs.empty() ? 0 :
+    header.namesOffset + header.namesLength;
+  index_type metaEnd = header.namesOffset + header.namesLength +
+    crcs.size()*sizeof(uint32_t);
+  header.dataOffset = (metaEnd + BINARY_DATA_ALIGNMENT - 1) /
+    BINARY_DATA_ALIGNMENT * BINARY_DATA_ALIGNMENT;
+
+  std::string outName = RChar2String(fileName);
+  int outFd = OpenFile(outName, O_WRONLY | O_CREAT | O_TRUNC);
+  if (outFd < 0)
+  {
+    Rf_error("Could not open %s for writing.", outName.c_str());
+  }
+  bool ok = WriteFully(outFd, reinterpret_cast<const char*>(&header),
+      sizeof(header), 0) &&
+    WriteFully(outFd, names.data(), names.size(), header.namesOffset) &&
+    (crcs.empty() || WriteFully(outFd,
+      reinterpret_cast<const char*>(&crcs[0]),
+      crcs.size()*sizeof(uint32_t), header.checksumOffset)) &&
+    ResizeFile(outFd, header.dataOffset + numCols*colBytes);
+
+  // File-backed data is copied file to file; anything else is written
+  // straight from memory.  Whole columns of a non-separated matrix are
+  // contiguous and go in a single copy.
+  FileBackedBigMatrix *pfbm = dynamic_cast<FileBackedBigMatrix*>(
+    static_cast<BigMatrix*>(pMat));
+  bool contiguous = !pMat->separated_columns() &&
+    numRows == pMat->total_rows();
+  index_type numPieces = contiguous ? 1 : numCols;
+  index_type pieceBytes = contiguous ? numCols*colBytes : colBytes;
+  index_type j;
+  for (j=0; ok && j < numPieces; ++j)
+  {
+    index_type outOffset = header.dataOffset + j*colBytes;
+    bool copied = false;
+    if (pfbm)
+    {
+      int inFd = OpenFile(pfbm->backing_file(pMat->col_offset()+j),
+        O_RDONLY);
+      if (inFd >= 0)
+      {
+        index_type inOffset = pMat->separated_columns() ?
+          pMat->row_offset() :
+          (pMat->col_offset()+j)*pMat->total_rows() + pMat->row_offset();
+        inOffset *= ElementSize(pMat->matrix_type());
+        if (!pMat->separated_columns()) inOffset += pfbm->data_offset();
+        copied = CopyFileBytes(inFd, inOffset, outFd, outOffset, pieceBytes);
+        CloseFile(inFd);
+      }
+    }
+    if (!copied)
+    {
+      ok = WriteFully(outFd, ColumnData(pMat, j), pieceBytes, outOffset);
+    }
+  }
+  CloseFile(outFd);
+  if (!ok)
+  {
+    Rf_error("Problem writing %s.", outName.c_str());
+  }
+  return Rf_ScalarLogical(1);
+}
+
+// Whether the header describes a matrix whose pieces all lie within a
+// file of fileSize bytes.
+static bool ValidHeader( const BinaryMatrixHeader &header,
+  const index_type fileSize )
+{
+  const int t = header.matrixType;
+  if ((t != 1 && t != 2 && t != 4 && t != 6 && t != 8) ||
+      header.numRows < 0 || header.numCols < 0)
+  {
+    return false;
+  }
+  const index_type maxIndex = std::numeric_limits<index_type>::max();
+  const index_type es = ElementSize(t);
+  if (header.numCols > 0 && header.numRows > maxIndex / es / header.numCols)
+  {
+    return false;
+  }
+  const index_type dataBytes = header.numRows * header.numCols * es;
+  if (header.namesOffset < 0 || header.namesOffset > fileSize ||
+      header.namesLength < 0 ||
+      header.namesLength > fileSize - header.namesOffset ||
+      header.dataOffset < 0 || header.dataOffset > fileSize ||
+      dataBytes > fileSize - header.dataOffset)
+  {
+    return false;
+  }
+  if (header.flags & BINARY_CHECKSUMS)
+  {
+    const index_type crcBytes = header.numCols * sizeof(uint32_t);
+    if (header.checksumOffset < 0 || header.checksumOffset > fileSize ||
+        crcBytes > fileSize - header.checksumOffset)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The body of CImportBigMatrix.  Returns an error message, or an empty
+// string with the new matrix in pMat, so that the caller raises any R
+// error only once every file here has been closed.
+static std::string ImportBigMatrix( const std::string &inName,
+  const std::string &backingFile, const std::string &backingPath,
+  const bool verify, const int numThreads, FileBackedBigMatrix *&pMat )
+{
+  pMat = NULL;
+  ScopedFile in(OpenFile(inName, O_RDONLY));
+  if (in.fd() < 0)
+  {
+    return "Could not open " + inName + ".";
+  }
+  BinaryMatrixHeader header;
+  if (!ReadFully(in.fd(), reinterpret_cast<char*>(&header), sizeof(header),
+        0) ||
+      memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0)
+  {
+    return inName + " is not a binary big.matrix file.";
+  }
+  if (header.byteOrder != BINARY_BYTE_ORDER ||
+      header.version > BINARY_VERSION)
+  {
+    return inName + " was written by an incompatible machine or version.";
+  }
+  if (!ValidHeader(header, FileSize(in.fd())))
+  {
+    return inName + " is damaged.";
+  }
+
+  Names colNames, rowNames;
+  std::string names(static_cast<std::size_t>(header.namesLength), '\0');
+  std::size_t pos = 0;
+  std::vector<uint32_t> crcs;
+  if (header.flags & BINARY_CHECKSUMS)
+  {
+    crcs.resize(static_cast<std::size_t>(header.numCols));
+  }
+  if ( (header.namesLength > 0 && !ReadFully(in.fd(), &names[0],
+        header.namesLength, header.namesOffset)) ||
+      !ReadNamesBlock(names, pos, colNames) ||
+      !ReadNamesBlock(names, pos, rowNames) ||
+      (!crcs.empty() && !ReadFully(in.fd(),
+        reinterpret_cast<char*>(&crcs[0]), crcs.size()*sizeof(uint32_t),
+        header.checksumOffset)) )
+  {
+    return inName + " is damaged.";
+  }
+
+  FileBackedBigMatrix *pNew = new FileBackedBigMatrix();
+  if (!pNew->create(backingFile, backingPath, header.numRows,
+    header.numCols, header.matrixType,
+    (header.flags & BINARY_SEPARATED) != 0))
+  {
+    delete pNew;
+    return "Problem creating filebacked matrix.";
+  }
+
+  // Copy the data straight into the new backing file(s).  The file
+  // mapping created above sees the result through the page cache.
+  const index_type colBytes = header.numRows *
+    ElementSize(header.matrixType);
+  bool contiguous = !pNew->separated_columns();
+  index_type numPieces = contiguous ? 1 : header.numCols;
+  index_type pieceBytes = contiguous ? header.numCols*colBytes : colBytes;
+  bool ok = true;
+  index_type j;
+  for (j=0; ok && j < numPieces; ++j)
+  {
+    index_type inOffset = header.dataOffset + j*colBytes;
+    ScopedFile out(OpenFile(pNew->backing_file(j), O_RDWR));
+    ok = out.fd() >= 0 && CopyFileBytes(in.fd(), inOffset, out.fd(),
+      pNew->data_offset(), pieceBytes);
+    if (!ok)
+    {
+      ok = ReadFully(in.fd(), ColumnData(pNew, j), pieceBytes,
+        inOffset);
+    }
+  }
+
+  if (ok && !crcs.empty() && verify)
+  {
+    std::vector<uint32_t> check;
+    ColumnChecksums(pNew, colBytes, numThreads, check);
+    ok = (check == crcs);
+  }
+  if (!ok)
+  {
+    Names backingFiles;
+    for (j=0; j < numPieces; ++j)
+    {
+      backingFiles.push_back(pNew->backing_file(j));
+    }
+    delete pNew;
+    for (j=0; j < numPieces; ++j)
+    {
+      remove(backingFiles[j].c_str());
+    }
+    return "The data in " + inName + " is damaged or could not be read.";
+  }
+  pNew->column_names(colNames);
+  pNew->row_names(rowNames);
+  pMat = pNew;
+  return std::string();
+}
+
+// [[Rcpp::export]]
+SEXP CImportBigMatrix(SEXP fileName, SEXP backingFile, SEXP backingPath,
+  SEXP verify, SEXP threads)
+{
+  FileBackedBigMatrix *pMat = NULL;
+  std::string err = ImportBigMatrix(RChar2String(fileName),
+    RChar2String(backingFile), RChar2String(backingPath),
+    LOGICAL(verify)[0] != 0, std::max(Rf_asInteger(threads), 1), pMat);
+  if (!err.empty())
+  {
+    Rf_error("%s", err.c_str());
+  }
+  SEXP address = R_MakeExternalPtr( dynamic_cast<BigMatrix*>(pMat),
+    R_NilValue, R_NilValue);
+  R_RegisterCFinalizerEx(address, (R_CFinalizer_t) CDestroyBigMatrix,
+      (Rboolean) TRUE);
+  return address;
+}
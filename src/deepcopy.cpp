@@ -2,127 +2,369 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <vector>
 
 #include <boost/lexical_cast.hpp>
 #include <Rcpp.h>
 
 #include "bigmemory/BigMatrix.h"
 #include "bigmemory/MatrixAccessor.hpp"
+#include "bigmemory/ElementKernels.hpp"
+#include "bigmemory/FileIO.hpp"
 #include "bigmemory/isna.hpp"
+#include "bigmemory/util.h"
 
-template<typename in_CType, typename in_BMAccessorType, 
-  typename out_CType, typename out_BMAccessorType>
-void DeepCopy(BigMatrix *pInMat, BigMatrix *pOutMat, SEXP rowInds, SEXP colInds)
-{
-  in_BMAccessorType inMat( *pInMat );
-  out_BMAccessorType outMat( *pOutMat );
-  
-  double *pRows = REAL(rowInds);
-  double *pCols = REAL(colInds);
-  index_type nRows = Rf_length(rowInds);
-  index_type nCols = Rf_length(colInds);
-  
-  if (nRows != pOutMat->nrow())
-    Rf_error("length of row indices does not equal # of rows in new matrix");
-  if (nCols != pOutMat->ncol())
-    Rf_error("length of col indices does not equal # of cols in new matrix");
-  
-  index_type i = 0;
-  index_type j = 0;
-  in_CType *pInColumn;
-  out_CType *pOutColumn;
-  
-  for (i = 0; i < nCols; ++i) {
-    pInColumn = inMat[static_cast<index_type>(pCols[i])-1];
-    pOutColumn = outMat[i];
-    for (j = 0; j < nRows; ++j) {
-      pOutColumn[j] = static_cast<out_CType>(
-        pInColumn[static_cast<index_type>(pRows[j])-1]);
+void TouchZoneMap( BigMatrix *pMat, SEXP col );
+
+// How each element type is read into R and assigned from R.  A deep copy
+// gives the same values as y[,j] <- x[rows, cols[j]] would: missing values
+// carry over, and values out of range of the new type become missing.
+template<typename CType>
+struct DeepCopyType;
+
+template<>
+struct DeepCopyType<char>
+{
+  typedef int RType;
+  static double na() {return NA_CHAR;}
+  static double na_r() {return NA_INTEGER;}
+  static double min() {return R_CHAR_MIN;}
+  static double max() {return R_CHAR_MAX;}
+};
+
+template<>
+struct DeepCopyType<short>
+{
+  typedef int RType;
+  static double na() {return NA_SHORT;}
+  static double na_r() {return NA_INTEGER;}
+  static double min() {return R_SHORT_MIN;}
+  static double max() {return R_SHORT_MAX;}
+};
+
+template<>
+struct DeepCopyType<int>
+{
+  typedef int RType;
+  static double na() {return NA_INTEGER;}
+  static double na_r() {return NA_INTEGER;}
+  static double min() {return R_INT_MIN;}
+  static double max() {return R_INT_MAX;}
+};
+
+template<>
+struct DeepCopyType<float>
+{
+  typedef double RType;
+  static double na() {return NA_FLOAT;}
+  static double na_r() {return NA_FLOAT;}
+  static double min() {return R_FLT_MIN;}
+  static double max() {return R_FLT_MAX;}
+};
+
+template<>
+struct DeepCopyType<double>
+{
+  typedef double RType;
+  static double na() {return NA_REAL;}
+  static double na_r() {return NA_REAL;}
+  static double min() {return R_DOUBLE_MIN;}
+  static double max() {return R_DOUBLE_MAX;}
+};
+
+// Convert between the two R types, as R's as.double and as.integer would.
+inline void ConvertRValues( const int *src, index_type n, int *dst )
+{
+  memcpy(dst, src, n*sizeof(int));
+}
+
+inline void ConvertRValues( const double *src, index_type n, double *dst )
+{
+  memcpy(dst, src, n*sizeof(double));
+}
+
+inline void ConvertRValues( const int *src, index_type n, double *dst )
+{
+  ToRValues<int, double>(src, n, dst, NA_INTEGER, NA_REAL);
+}
+
+inline void ConvertRValues( const double *src, index_type n, int *dst )
+{
+  index_type i;
+  for (i=0; i < n; ++i)
+  {
+    dst[i] = (isna(src[i]) || src[i] < R_INT_MIN || src[i] > R_INT_MAX) ?
+      NA_INTEGER : static_cast<int>(src[i]);
+  }
+}
+
+// The number of elements converted at a time through the R types.
+const index_type DEEP_COPY_CHUNK = 1024;
+
+// Copy n elements of one type into another.
+template<typename InType, typename OutType>
+void CopyRun( const InType *src, index_type n, OutType *dst )
+{
+  typedef DeepCopyType<InType> In;
+  typedef DeepCopyType<OutType> Out;
+  typename In::RType inR[DEEP_COPY_CHUNK];
+  typename Out::RType outR[DEEP_COPY_CHUNK];
+  index_type i, chunk;
+  for (i=0; i < n; i += chunk)
+  {
+    chunk = std::min(DEEP_COPY_CHUNK, n-i);
+    ToRValues(src+i, chunk, inR, In::na(), In::na_r());
+    ConvertRValues(inR, chunk, outR);
+    FromRValues(outR, chunk, dst+i, Out::na(), Out::min(), Out::max());
+  }
+}
+
+// A type copied to itself is copied as it is.
+template<>
+void CopyRun<char, char>( const char *src, index_type n, char *dst )
+{
+  memcpy(dst, src, n*sizeof(char));
+}
+
+template<>
+void CopyRun<short, short>( const short *src, index_type n, short *dst )
+{
+  memcpy(dst, src, n*sizeof(short));
+}
+
+template<>
+void CopyRun<int, int>( const int *src, index_type n, int *dst )
+{
+  memcpy(dst, src, n*sizeof(int));
+}
+
+template<>
+void CopyRun<float, float>( const float *src, index_type n, float *dst )
+{
+  memcpy(dst, src, n*sizeof(float));
+}
+
+template<>
+void CopyRun<double, double>( const double *src, index_type n, double *dst )
+{
+  memcpy(dst, src, n*sizeof(double));
+}
+
+template<typename T>
+void ColumnPointers( BigMatrix *pMat, std::vector<T*> &columns )
+{
+  columns.resize(pMat->ncol());
+  index_type j;
+  if (pMat->separated_columns())
+  {
+    SepMatrixAccessor<T> mat(*pMat);
+    for (j=0; j < pMat->ncol(); ++j)
+    {
+      columns[j] = mat[j];
+    }
+  }
+  else
+  {
+    MatrixAccessor<T> mat(*pMat);
+    for (j=0; j < pMat->ncol(); ++j)
+    {
+      columns[j] = mat[j];
     }
   }
-  
-  return;
 }
 
+// Whether the columns of the (sub)matrix follow one another in memory.
+inline bool ContiguousColumns( BigMatrix *pMat )
+{
+  return !pMat->separated_columns() && pMat->nrow() == pMat->total_rows();
+}
+
+// Copy the rows named by rowRuns of the 1-based columns pCols of pInMat
+// into pOutMat, one column at a time, shared among numThreads threads.
+template<typename InType, typename OutType>
+void DeepCopy( BigMatrix *pInMat, BigMatrix *pOutMat,
+  const std::vector<IndexRun> &rowRuns, const double *pCols, int numThreads )
+{
+  std::vector<InType*> inCols;
+  std::vector<OutType*> outCols;
+  ColumnPointers(pInMat, inCols);
+  ColumnPointers(pOutMat, outCols);
+  const index_type nRows = pOutMat->nrow();
+  const index_type nCols = pOutMat->ncol();
+  if (nRows == 0 || nCols == 0) return;
 
-// [[Rcpp::export]]
-SEXP CDeepCopy(SEXP inAddr, SEXP outAddr, SEXP rowInds, SEXP colInds, 
-    SEXP typecast_warning)
+  // Whole columns of one contiguous matrix going to another are a single
+  // run, as many columns at a time as are consecutive.
+  if (rowRuns.size() == 1 && rowRuns[0].first == 0 &&
+    rowRuns[0].length == pInMat->total_rows() &&
+    ContiguousColumns(pInMat) && ContiguousColumns(pOutMat))
   {
-      
-    #define CALL_DEEP_COPY_2(IN_CTYPE, IN_ACCESSOR, OUT_ACCESSOR) \
-    switch(pOutMat->matrix_type()) \
-    { \
-      case 1: \
-        DeepCopy<IN_CTYPE, IN_ACCESSOR<IN_CTYPE>, char, OUT_ACCESSOR<char> >( \
-          pInMat, pOutMat, rowInds, colInds); \
-        break; \
-      case 2: \
-        DeepCopy<IN_CTYPE, IN_ACCESSOR<IN_CTYPE>, short, OUT_ACCESSOR<short> >( \
-          pInMat, pOutMat, rowInds, colInds); \
-        break; \
-      case 4: \
-        DeepCopy<IN_CTYPE, IN_ACCESSOR<IN_CTYPE>, int, OUT_ACCESSOR<int> >( \
-          pInMat, pOutMat, rowInds, colInds); \
-        break; \
-      case 8: \
-        DeepCopy<IN_CTYPE, IN_ACCESSOR<IN_CTYPE>, double, OUT_ACCESSOR<double> >( \
-          pInMat, pOutMat, rowInds, colInds); \
-        break; \
+    std::vector<IndexRun> colRuns;
+    FindIndexRuns(pCols, nCols, colRuns);
+    if (colRuns.size() == 1)
+    {
+      CopyRun(inCols[colRuns[0].first], nRows*nCols, outCols[0]);
+      return;
     }
+  }
 
-    #define CALL_DEEP_COPY_1(IN_ACCESSOR, OUT_ACCESSOR) \
-    switch(pInMat->matrix_type()) \
-    { \
-      case 1: \
-        CALL_DEEP_COPY_2(char, IN_ACCESSOR, OUT_ACCESSOR) \
-        break; \
-      case 2: \
-        CALL_DEEP_COPY_2(short, IN_ACCESSOR, OUT_ACCESSOR) \
-        break; \
-      case 4: \
-        CALL_DEEP_COPY_2(int, IN_ACCESSOR, OUT_ACCESSOR) \
-        break; \
-      case 8: \
-        CALL_DEEP_COPY_2(double, IN_ACCESSOR, OUT_ACCESSOR) \
-        break; \
+  // Small copies aren't worth the threads.
+  if (nRows*nCols < 65536) numThreads = 1;
+  index_type j;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+#endif
+  for (j=0; j < nCols; ++j)
+  {
+    const InType *pIn = inCols[static_cast<index_type>(pCols[j])-1];
+    OutType *pOut = outCols[j];
+    std::vector<IndexRun>::const_iterator it;
+    for (it = rowRuns.begin(); it != rowRuns.end(); ++it)
+    {
+      CopyRun(pIn + it->first, it->length, pOut);
+      pOut += it->length;
+    }
+  }
+}
+
+// Whole columns copied from one file-backed matrix into another of the
+// same type are copied between the backing files, so that a file system
+// that can share extents makes the copy without moving any data.  The
+// destination's mapping sees the result through the page cache.  Returns
+// false if the copy has to go through memory instead.
+bool CloneColumns( BigMatrix *pInMat, BigMatrix *pOutMat,
+  const std::vector<IndexRun> &rowRuns, const double *pCols )
+{
+  FileBackedBigMatrix *pIn = dynamic_cast<FileBackedBigMatrix*>(pInMat);
+  FileBackedBigMatrix *pOut = dynamic_cast<FileBackedBigMatrix*>(pOutMat);
+  if (!pIn || !pOut || pOut->read_only() ||
+    pIn->matrix_type() != pOut->matrix_type() ||
+    pIn->row_offset() != 0 || pIn->nrow() != pIn->total_rows() ||
+    pOut->row_offset() != 0 || pOut->nrow() != pOut->total_rows() ||
+    rowRuns.size() != 1 || rowRuns[0].first != 0 ||
+    rowRuns[0].length != pIn->total_rows() ||
+    pIn->backing_file(0) == pOut->backing_file(0))
+  {
+    return false;
+  }
+  const bool inSep = pIn->separated_columns();
+  const bool outSep = pOut->separated_columns();
+  const index_type colBytes = pIn->total_rows() *
+    (pIn->matrix_type() == 6 ? static_cast<index_type>(sizeof(float)) :
+      static_cast<index_type>(pIn->matrix_type()));
+  index_type j=0, n;
+  while (j < pOut->ncol())
+  {
+    index_type inCol = pIn->col_offset() + 
+      static_cast<index_type>(pCols[j]) - 1;
+    index_type outCol = pOut->col_offset() + j;
+    // Columns that follow one another in both files go together.
+    n = 1;
+    while (!inSep && !outSep && j+n < pOut->ncol() &&
+      pCols[j+n] == pCols[j] + n)
+    {
+      ++n;
+    }
+    int inFd = OpenFile(pIn->backing_file(inCol), O_RDONLY);
+    int outFd = OpenFile(pOut->backing_file(outCol), O_RDWR);
+    bool ok = inFd >= 0 && outFd >= 0 &&
+      CloneFileBytes(inFd, inSep ? 0 : pIn->data_offset() + inCol*colBytes,
+        outFd, outSep ? 0 : pOut->data_offset() + outCol*colBytes,
+        n*colBytes);
+    CloseFile(inFd);
+    CloseFile(outFd);
+    if (!ok)
+    {
+      return false;
     }
-      
+    j += n;
+  }
+  return true;
+}
+
+typedef void (*DeepCopyFunction)( BigMatrix*, BigMatrix*,
+  const std::vector<IndexRun>&, const double*, int );
+
+// The position of each matrix type in the dispatch table, or -1.
+inline int DeepCopyTypeIndex( const int matrixType )
+{
+  switch (matrixType)
+  {
+    case 1: return 0;
+    case 2: return 1;
+    case 4: return 2;
+    case 6: return 3;
+    case 8: return 4;
+  }
+  return -1;
+}
+
+#define DEEP_COPY_ROW(IN_CTYPE) \
+  { DeepCopy<IN_CTYPE, char>, DeepCopy<IN_CTYPE, short>, \
+    DeepCopy<IN_CTYPE, int>, DeepCopy<IN_CTYPE, float>, \
+    DeepCopy<IN_CTYPE, double> }
+
+static const DeepCopyFunction deepCopyFunctions[5][5] = {
+  DEEP_COPY_ROW(char), DEEP_COPY_ROW(short), DEEP_COPY_ROW(int),
+  DEEP_COPY_ROW(float), DEEP_COPY_ROW(double)
+};
+
+// [[Rcpp::export]]
+SEXP CDeepCopy(SEXP inAddr, SEXP outAddr, SEXP rowInds, SEXP colInds,
+    SEXP typecast_warning, SEXP threads)
+  {
     BigMatrix *pInMat = reinterpret_cast<BigMatrix*>(
       R_ExternalPtrAddr(inAddr));
     BigMatrix *pOutMat = reinterpret_cast<BigMatrix*>(
       R_ExternalPtrAddr(outAddr));
-    
-    if ((pOutMat->matrix_type() < pInMat->matrix_type()) & 
+
+    if ((pOutMat->matrix_type() < pInMat->matrix_type()) &
       (Rf_asLogical(typecast_warning) == (Rboolean)TRUE))
     {
       string type_names[9] = {
-        "", "char", "short", "", "integer", "", "", "", "double"};
-      
-      std::string warnMsg = string("Assignment will down cast from ") + 
-        type_names[pInMat->matrix_type()] + string(" to ") + 
-        type_names[pOutMat->matrix_type()] + string("\n") + 
-        string("Hint: To remove this warning type: ") + 
+        "", "char", "short", "", "integer", "", "float", "", "double"};
+
+      std::string warnMsg = string("Assignment will down cast from ") +
+        type_names[pInMat->matrix_type()] + string(" to ") +
+        type_names[pOutMat->matrix_type()] + string("\n") +
+        string("Hint: To remove this warning type: ") +
         string("options(bigmemory.typecast.warning=FALSE)");
       Rf_warning(warnMsg.c_str());
     }
-    
-    // Not sure if there is a better way to do these function calls
-    if (pInMat->separated_columns() && pOutMat->separated_columns()) {
-      CALL_DEEP_COPY_1(SepMatrixAccessor, SepMatrixAccessor)
-    }
-    else if(pInMat->separated_columns() && !(pOutMat->separated_columns()))
+
+    std::vector<IndexRun> rowRuns;
+    index_type nRows = GetIndexRuns(rowInds, rowRuns);
+    std::vector<double> cols;
+    index_type nCols = GetIndices(colInds, cols);
+    if (nRows != pOutMat->nrow())
+      Rf_error("length of row indices does not equal # of rows in new matrix");
+    if (nCols != pOutMat->ncol())
+      Rf_error("length of col indices does not equal # of cols in new matrix");
+
+    int inType = DeepCopyTypeIndex(pInMat->matrix_type());
+    int outType = DeepCopyTypeIndex(pOutMat->matrix_type());
+    if (inType < 0 || outType < 0)
+      Rf_error("unsupported matrix type");
+
+    std::vector<IndexRun>::const_iterator it;
+    for (it = rowRuns.begin(); it != rowRuns.end(); ++it)
     {
-      CALL_DEEP_COPY_1(SepMatrixAccessor, MatrixAccessor)
+      if (it->first < 0)
+        Rf_error("row indices may not be missing");
     }
-    else if(!(pInMat->separated_columns()) && pOutMat->separated_columns())
+    index_type j;
+    for (j=0; j < nCols; ++j)
     {
-      CALL_DEEP_COPY_1(MatrixAccessor, SepMatrixAccessor)
+      if (isna(cols[j]))
+        Rf_error("column indices may not be missing");
     }
-    else
+    if (nCols == 0) return R_NilValue;
+    if (!CloneColumns(pInMat, pOutMat, rowRuns, &cols[0]))
     {
-      CALL_DEEP_COPY_1(MatrixAccessor, MatrixAccessor)
+      deepCopyFunctions[inType][outType](pInMat, pOutMat, rowRuns,
+        &cols[0], std::max(Rf_asInteger(threads), 1));
     }
+    TouchZoneMap(pOutMat, R_NilValue);
 
     return R_NilValue;
   }
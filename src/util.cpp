@@ -50,3 +50,62 @@ SEXP String2RChar(const std::string &str)
 {
   return Rcpp::wrap(str);
 }
+
+const double* IndexChunk( SEXP indices, const index_type first,
+  const index_type n, double *buffer )
+{
+#if defined(R_VERSION) && R_VERSION >= R_Version(3, 5, 0)
+  if (ALTREP(indices))
+  {
+    REAL_GET_REGION(indices, first, n, buffer);
+    return buffer;
+  }
+#endif
+  return REAL(indices) + first;
+}
+
+index_type GetIndexRuns( SEXP indices, std::vector<IndexRun> &runs )
+{
+  runs.clear();
+  index_type total=0;
+  index_type i;
+  if (Rf_inherits(indices, "index.runs"))
+  {
+    const index_type numRuns = Rf_nrows(indices);
+    const double *pRuns = REAL(indices);
+    runs.resize(numRuns);
+    for (i=0; i < numRuns; ++i)
+    {
+      runs[i].first = static_cast<index_type>(pRuns[i]) - 1;
+      runs[i].length = static_cast<index_type>(pRuns[numRuns+i]);
+      total += runs[i].length;
+    }
+    return total;
+  }
+  total = Rf_xlength(indices);
+  double buffer[INDEX_CHUNK];
+  index_type n;
+  for (i=0; i < total; i += n)
+  {
+    n = std::min(INDEX_CHUNK, total - i);
+    AppendIndexRuns(IndexChunk(indices, i, n, buffer), n, runs);
+  }
+  return total;
+}
+
+index_type GetIndices( SEXP indices, std::vector<double> &values )
+{
+  std::vector<IndexRun> runs;
+  values.resize(GetIndexRuns(indices, runs));
+  std::vector<IndexRun>::const_iterator it;
+  std::vector<double>::iterator out = values.begin();
+  index_type i;
+  for (it = runs.begin(); it != runs.end(); ++it)
+  {
+    for (i=0; i < it->length; ++i, ++out)
+    {
+      *out = it->first < 0 ? NA_REAL : static_cast<double>(it->first + i + 1);
+    }
+  }
+  return static_cast<index_type>(values.size());
+}